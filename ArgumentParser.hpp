@@ -321,7 +321,10 @@ private:
     for (std::map<std::string, std::vector<OptionItem>::size_type>::const_iterator itr = longOptMap.begin(); itr != longOptMap.end(); ++itr) {
       const std::pair<std::string, std::vector<OptionItem>& kv = *itr;
 #endif  //  __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
-      if (kv.first.find(longOptName) == 0) {
+      if (kv.first == longOptName) {
+        indices.assign(1, kv.second);
+        break;
+      } else if (kv.first.find(longOptName) == 0) {
         indices.push_back(kv.second);
       }
     }
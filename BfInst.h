@@ -19,6 +19,9 @@ struct BfInst
   kLoopStart, kLoopEnd, kIf, kEndIf, \
   kAssign, kSearchZero, \
   kAddVar, kSubVar, kAddCMulVar, \
+  kAddVarFrom, kSubVarFrom, \
+  kMovePointerAdd, kAddMovePointer, kMovePointerAssign, kAssignMovePointer, \
+  kMovePointerIf, kMovePointerLoopEnd, \
   kInfLoop, \
   kBreakPoint, \
   kUnknown
@@ -46,6 +49,12 @@ struct BfInst
     {
       BF_INST_INSTRUCTIONS
     };
+    /*!
+     * @brief Default ctor
+     */
+    Type() :
+      value()
+    {}
     /*!
      * @brief Ctor for implicit conversion: Actual enum to dummy enum class
      * @param [in] value  Actual enum value
@@ -9,16 +9,26 @@
 #include <cassert>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
 #include <exception>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <memory>
-#include <queue>
+#include <set>
+#include <map>
+#include <sstream>
 #include <stack>
+#include <stdexcept>
 #include <string>
 #include <vector>
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+#  include <cstdint>
+#else
+#  include <stdint.h>
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
 
 #include "CodeGenerator/CodeGenerator.hpp"
 
@@ -47,12 +57,26 @@
 #  endif  // __cplusplus >= 201103L
 #endif  // BRAINFUCK_GNUC_PREREQ(4, 6)
 #include <xbyak/xbyak.h>
+#include <xbyak/xbyak_util.h>
 #if BRAINFUCK_GNUC_PREREQ(4, 6)
 #  pragma GCC diagnostic pop
 #endif  // BRAINFUCK_GNUC_PREREQ(4, 6)
 
 
 #include "BfInst.h"
+#include "InputReader.hpp"
+#include "HugePages.hpp"
+#include "IRFile.hpp"
+#include "JitCache.hpp"
+#include "OutputSink.hpp"
+#include "Tape.hpp"
+
+#if defined(TAPE_OVERFLOW_CHECK_AVAILABLE) && defined(__linux__)
+#  include <ucontext.h>
+//! Output which native code has not passed to the output sink is recovered
+//! from the registers on tape overflow
+#  define BRAINFUCK_JIT_OUTPUT_RECOVERY_AVAILABLE
+#endif  // defined(TAPE_OVERFLOW_CHECK_AVAILABLE) && defined(__linux__)
 
 #if defined(__cplusplus) && __cplusplus >= 201103 \
   || defined(_MSC_VER) && (_MSC_VER > 1800 || _MSC_FULL_VER == 180021114)
@@ -63,6 +87,14 @@
 #  define BRAINFUCK_NOEXCEPT  throw()
 #endif
 
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+//! Polyfill macro of @code override @endcode
+#  define BRAINFUCK_OVERRIDE  override
+#else
+//! Polyfill macro of @code override @endcode
+#  define BRAINFUCK_OVERRIDE
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+
 #if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
 #  define BRAINFUCK_EMPLACE_AVAILABLE
 #endif //  __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
@@ -76,12 +108,44 @@
 #  define BRAINFUCK_UNLIKELY(x)  (x)
 #endif  //  __GNUC__
 
+#if defined(__GNUC__) && !defined(BRAINFUCK_NO_COMPUTED_GOTO)
+//! Labels as values (computed goto) is available
+#  define BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+#endif  // defined(__GNUC__) && !defined(BRAINFUCK_NO_COMPUTED_GOTO)
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || defined(_M_IX86_FP) && _M_IX86_FP >= 2
+//! SSE2 intrinsics are available
+#  define BRAINFUCK_SSE2_AVAILABLE
+#  include <emmintrin.h>
+#  if defined(__GNUC__) && (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__) \
+    || defined(_MSC_VER) && _MSC_VER >= 1700
+//! AVX2 intrinsics are available with runtime CPU detection
+#    define BRAINFUCK_AVX2_AVAILABLE
+#    include <immintrin.h>
+#  endif  // defined(__GNUC__) && (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__) || defined(_MSC_VER) && _MSC_VER >= 1700
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ || defined(_WIN32)
+//! Zero bytes are searched with 64-bit integer operations
+#  define BRAINFUCK_SWAR_AVAILABLE
+#endif  // defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || defined(_M_IX86_FP) && _M_IX86_FP >= 2
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif  // _MSC_VER
+
+
+static void
+writeJitOutput(const unsigned char* buffer, std::size_t size, OutputSink* sink) BRAINFUCK_NOEXCEPT
+{
+  sink->write(buffer, size);
+}
+
 
 static int
-getcharWithFlush() BRAINFUCK_NOEXCEPT
+readJitInput(const unsigned char* buffer, std::size_t size, OutputSink* sink) BRAINFUCK_NOEXCEPT
 {
-  std::fflush(stdout);
-  return std::getchar();
+  InputReader& input = InputReader::getStdin();
+  sink->write(buffer, size);
+  sink->flushBeforeInput(input.isFlushNeeded());
+  return input.get();
 }
 
 
@@ -110,7 +174,7 @@ public:
    */
   enum class CompileType
   {
-    kIR, kJit, kUnknown
+    kIR, kJit, kTiered, kUnknown
   };  // enum class CompileType
 #else
   /*!
@@ -124,7 +188,7 @@ public:
      */
     enum CompileTypeEnum
     {
-      kIR, kJit, kUnknown
+      kIR, kJit, kTiered, kUnknown
     };
     /*!
      * @brief Ctor for implicit conversion: Actual enum to dummy enum class
@@ -195,6 +259,46 @@ public:
   };  // class Target
 #endif  // __cplusplus >= 201103L
 
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1700)
+  /*!
+   * @brief Dispatch method of IR code interpreter
+   */
+  enum class DispatchType
+  {
+    kSwitch, kThreaded, kPacked
+  };  // enum class DispatchType
+#else
+  class DispatchType
+  {
+  public:
+    /*!
+     * @brief Actual enum of dispatch method
+     */
+    enum DispatchTypeEnum
+    {
+      kSwitch, kThreaded, kPacked
+    };
+    /*!
+     * @brief Ctor for implicit conversion: Actual enum to dummy enum class
+     * @param [in] value  Actual enum value
+     */
+    DispatchType(DispatchTypeEnum value) :
+      value(value)
+    {}
+    /*!
+     * @brief operator () for implicit conversion: Dummy enum class to actual
+     *        enum
+     * @return Actual enum value
+     */
+    operator DispatchTypeEnum() const throw()
+    {
+      return value;
+    }
+  private:
+    DispatchTypeEnum value;
+  };  // class DispatchType
+#endif  // __cplusplus >= 201103L
+
 private:
 #if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1700)
   enum class XbyakDirection
@@ -221,18 +325,584 @@ private:
   };  // class XbyakDirection
 #endif  // __cplusplus >= 201103L
 
+  /*!
+   * @brief One instruction of threaded code
+   */
+  struct ThreadedInst
+  {
+#ifdef BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+    //! Address of instruction handler
+    const void* label;
+#else
+    //! Instruction type
+    BfInst::Type type;
+#endif  // BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+    //! Resolved jump destination
+    const ThreadedInst* jump;
+    //! Operand 1
+    int op1;
+    //! Operand 2
+    int op2;
+  };  // struct ThreadedInst
+
+  /*!
+   * @brief Affine expression of cell values at the start of a loop iteration
+   */
+  struct AffineExpr
+  {
+    //! Coefficients of cell values modulo 2^cellBits, keyed by offsets of
+    //! the cells
+    std::map<int, std::uint64_t> coefficients;
+    //! Constant term modulo 2^cellBits
+    std::uint64_t constant;
+
+    /*!
+     * @brief Ctor: zero
+     */
+    AffineExpr() :
+      coefficients(),
+      constant(0)
+    {}
+  };  // struct AffineExpr
+
+  /*!
+   * @brief Part of brainfuck source code which an IR instruction comes from
+   */
+  struct SourceRange
+  {
+    //! Offset of the first byte in bfSource
+    std::size_t begin;
+    //! Offset past the last byte in bfSource
+    std::size_t end;
+    //! Optimization which produced the instruction, or NULL if the
+    //! instruction is translated directly
+    const char* origin;
+
+    /*!
+     * @brief Ctor
+     * @param [in] begin   Offset of the first byte in bfSource
+     * @param [in] end     Offset past the last byte in bfSource
+     * @param [in] origin  Optimization which produced the instruction
+     */
+    explicit SourceRange(std::size_t begin=0, std::size_t end=0, const char* origin=NULL) :
+      begin(begin),
+      end(end),
+      origin(origin)
+    {}
+  };  // struct SourceRange
+
+  /*!
+   * @brief Known cell values at a point of IR code
+   */
+  struct TapeState
+  {
+    //! Known cell values (-1 if unknown), keyed by offsets from the base
+    std::map<int, std::int64_t> valueMap;
+    //! Values on the tape (-1 if unknown) of the cells whose known values are
+    //! not written to the tape yet, keyed by offsets from the base
+    std::map<int, std::int64_t> dirtyMap;
+    //! Source ranges of the instructions which set the pending values last,
+    //! keyed by offsets from the base
+    std::map<int, SourceRange> rangeMap;
+    //! True if the cells not in valueMap are zero
+    bool isRestZero;
+    //! Offset of the pointer from the base
+    int pointer;
+
+    /*!
+     * @brief Ctor: state at the beginning of the program
+     */
+    TapeState() :
+      valueMap(),
+      dirtyMap(),
+      rangeMap(),
+      isRestZero(true),
+      pointer(0)
+    {}
+  };  // struct TapeState
+
+  /*!
+   * @brief Comparator of instruction indices by execution count in
+   *        descending order
+   */
+  struct ProfileCountGreater
+  {
+    //! Execution counts of IR instructions
+    const std::vector<std::uint64_t>& counts;
+
+    /*!
+     * @brief Ctor
+     * @param [in] counts  Execution counts of IR instructions
+     */
+    explicit ProfileCountGreater(const std::vector<std::uint64_t>& counts) BRAINFUCK_NOEXCEPT :
+      counts(counts)
+    {}
+
+    /*!
+     * @brief Compare two instructions
+     * @param [in] pc1  Index of an instruction
+     * @param [in] pc2  Index of another instruction
+     * @return True if pc1 is executed more than pc2, otherwise false
+     */
+    bool
+    operator()(std::size_t pc1, std::size_t pc2) const BRAINFUCK_NOEXCEPT
+    {
+      return counts[pc1] > counts[pc2];
+    }
+  };  // struct ProfileCountGreater
+
+#ifdef XBYAK32
+  //! Number of registers which hold cells in native code
+  static const int kNCellRegisters = 2;
+#else
+  //! Number of registers which hold cells in native code
+  static const int kNCellRegisters = 6;
+#endif  // XBYAK32
+
+  /*!
+   * @brief Cells held in registers by native code
+   */
+  struct CellCache
+  {
+    //! Offsets of the cells from the pointer, keyed by register indexes
+    int offsets[kNCellRegisters];
+    //! True if the register holds a cell
+    bool isUsed[kNCellRegisters];
+    //! True if the register holds a value not written back to the tape yet
+    bool isDirty[kNCellRegisters];
+    //! Time when the register was used last
+    int lastUses[kNCellRegisters];
+    //! Current time
+    int clock;
+
+    /*!
+     * @brief Ctor: no cells are held
+     */
+    CellCache() :
+      clock(0)
+    {
+      std::fill_n(offsets, kNCellRegisters, 0);
+      std::fill_n(isUsed, kNCellRegisters, false);
+      std::fill_n(isDirty, kNCellRegisters, false);
+      std::fill_n(lastUses, kNCellRegisters, 0);
+    }
+  };  // struct CellCache
+
+  /*!
+   * @brief Allocator of the native code buffer backed by huge pages
+   *
+   * Falls back to the default allocator of Xbyak if huge pages are not
+   * available.
+   */
+  class HugePageCodeAllocator : public Xbyak::Allocator
+  {
+  public:
+    /*!
+     * @brief Ctor
+     */
+    HugePageCodeAllocator() :
+      mapSizes()
+    {}
+
+    /*!
+     * @brief Allocate a code buffer
+     * @param [in] size  Size of the buffer
+     * @return Allocated buffer
+     */
+    Xbyak::uint8*
+    alloc(std::size_t size) BRAINFUCK_OVERRIDE
+    {
+#if !defined(_WIN32)
+      std::size_t mapSize = (size + HugePages::kSize - 1) / HugePages::kSize * HugePages::kSize;
+      void* p = HugePages::map(mapSize, PROT_READ | PROT_WRITE);
+      if (p != NULL) {
+        mapSizes[static_cast<Xbyak::uint8*>(p)] = mapSize;
+        return static_cast<Xbyak::uint8*>(p);
+      }
+#endif  // !defined(_WIN32)
+      return Xbyak::Allocator::alloc(size);
+    }
+
+    /*!
+     * @brief Free a code buffer
+     * @param [in] p  Buffer allocated by alloc()
+     */
+    void
+    free(Xbyak::uint8* p) BRAINFUCK_OVERRIDE
+    {
+#if !defined(_WIN32)
+      std::map<Xbyak::uint8*, std::size_t>::iterator itr = mapSizes.find(p);
+      if (itr != mapSizes.end()) {
+        munmap(p, itr->second);
+        mapSizes.erase(itr);
+        return;
+      }
+#endif  // !defined(_WIN32)
+      Xbyak::Allocator::free(p);
+    }
+
+    /*!
+     * @brief Get the allocator shared by all Brainfuck objects
+     * @return The allocator
+     */
+    static HugePageCodeAllocator&
+    getInstance() BRAINFUCK_NOEXCEPT
+    {
+      static HugePageCodeAllocator allocator;
+      return allocator;
+    }
+
+  private:
+    //! Sizes of the regions mapped with HugePages
+    std::map<Xbyak::uint8*, std::size_t> mapSizes;
+  };  // class HugePageCodeAllocator
+
+  /*!
+   * @brief Process-wide pool of native code buffers
+   *
+   * Freed buffers are kept and handed out again for the same size, so that
+   * Brainfuck objects created one after another in a process do not map and
+   * unmap code pages every time.
+   * Xbyak makes a buffer writable again before freeing it.
+   * The pool is not thread-safe, as the other parts of Brainfuck.
+   */
+  class CodeBufferPool : public Xbyak::Allocator
+  {
+  public:
+    //! Maximum number of free buffers kept in the pool
+    static const std::size_t kMaxFreeBuffers = 8;
+
+    /*!
+     * @brief Ctor
+     * @param [in] allocator      Allocator which actually allocates the
+     *                            buffers
+     * @param [in] isDiscardable  True if pages of the buffers can be released
+     *                            with discardUnused()
+     */
+    explicit CodeBufferPool(Xbyak::Allocator& allocator, bool isDiscardable) :
+      allocator(allocator),
+      isDiscardable(isDiscardable),
+      freeBuffers(),
+      bufferSizes()
+    {}
+
+    /*!
+     * @brief Dtor: release the free buffers
+     */
+    ~CodeBufferPool()
+    {
+      for (std::multimap<std::size_t, Xbyak::uint8*>::iterator itr = freeBuffers.begin(); itr != freeBuffers.end(); ++itr) {
+        allocator.free(itr->second);
+      }
+    }
+
+    /*!
+     * @brief Take a buffer from the pool, or allocate a new one
+     * @param [in] size  Size of the buffer
+     * @return The buffer
+     */
+    Xbyak::uint8*
+    alloc(std::size_t size) BRAINFUCK_OVERRIDE
+    {
+      Xbyak::uint8* p;
+      std::multimap<std::size_t, Xbyak::uint8*>::iterator itr = freeBuffers.find(size);
+      if (itr != freeBuffers.end()) {
+        p = itr->second;
+        freeBuffers.erase(itr);
+      } else {
+        p = allocator.alloc(size);
+      }
+      bufferSizes[p] = size;
+      return p;
+    }
+
+    /*!
+     * @brief Return a buffer to the pool, or free it if the pool is full
+     * @param [in] p  Buffer taken by alloc()
+     */
+    void
+    free(Xbyak::uint8* p) BRAINFUCK_OVERRIDE
+    {
+      std::map<Xbyak::uint8*, std::size_t>::iterator itr = bufferSizes.find(p);
+      if (itr == bufferSizes.end()) {
+        return;
+      }
+      if (freeBuffers.size() < kMaxFreeBuffers) {
+        freeBuffers.insert(std::make_pair(itr->second, p));
+      } else {
+        allocator.free(p);
+      }
+      bufferSizes.erase(itr);
+    }
+
+    /*!
+     * @brief Release the whole pages after the code in a buffer
+     *
+     * The pages stay mapped and are filled with zero when they are touched
+     * again, so the buffer can be reused with its full size.
+     * Buffers backed by huge pages are kept as they are.
+     * @param [in] p         Buffer taken by alloc()
+     * @param [in] usedSize  Size of the code in the buffer
+     */
+    void
+    discardUnused(const Xbyak::uint8* p, std::size_t usedSize) BRAINFUCK_NOEXCEPT
+    {
+#if defined(_WIN32) || !defined(MADV_DONTNEED)
+      static_cast<void>(p);
+      static_cast<void>(usedSize);
+#else
+      std::map<Xbyak::uint8*, std::size_t>::const_iterator itr = bufferSizes.find(const_cast<Xbyak::uint8*>(p));
+      if (!isDiscardable || itr == bufferSizes.end()) {
+        return;
+      }
+      std::size_t pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+      std::uintptr_t start = (reinterpret_cast<std::uintptr_t>(p) + usedSize + pageSize - 1) / pageSize * pageSize;
+      std::uintptr_t end = (reinterpret_cast<std::uintptr_t>(p) + itr->second) / pageSize * pageSize;
+      if (start < end) {
+        madvise(reinterpret_cast<void*>(start), end - start, MADV_DONTNEED);
+      }
+#endif  // defined(_WIN32) || !defined(MADV_DONTNEED)
+    }
+
+    /*!
+     * @brief Get the pool shared by all Brainfuck objects
+     * @param [in] useHugePages  Get the pool of buffers backed by huge pages
+     * @return The pool
+     */
+    static CodeBufferPool&
+    getInstance(bool useHugePages) BRAINFUCK_NOEXCEPT
+    {
+      static Xbyak::Allocator defaultAllocator;
+      static CodeBufferPool pool(defaultAllocator, true);
+      static CodeBufferPool hugePagePool(HugePageCodeAllocator::getInstance(), false);
+      return useHugePages ? hugePagePool : pool;
+    }
+
+  private:
+    //! Allocator which actually allocates the buffers
+    Xbyak::Allocator& allocator;
+    //! True if pages of the buffers can be released
+    bool isDiscardable;
+    //! Free buffers by their sizes
+    std::multimap<std::size_t, Xbyak::uint8*> freeBuffers;
+    //! Sizes of the buffers in use
+    std::map<Xbyak::uint8*, std::size_t> bufferSizes;
+
+    CodeBufferPool(const CodeBufferPool&);
+    CodeBufferPool&
+    operator=(const CodeBufferPool&);
+  };  // class CodeBufferPool
+
+  //! Native code of a loop, which takes the same arguments as the native code
+  //! of a whole program and returns the pointer after the loop
+  typedef void* (*NativeLoop)(void (*)(const unsigned char*, std::size_t, OutputSink*),
+      int (*)(const unsigned char*, std::size_t, OutputSink*), void*, OutputSink*);
+
+  /*!
+   * @brief Back-edge counts and native code of the loops in tiered execution
+   *
+   * Both are indexed by IR instruction indices: the counts by the index of
+   * the instruction which closes a loop, and the native code by the index of
+   * kLoopStart.
+   */
+  class NativeLoopTable
+  {
+  public:
+    /*!
+     * @brief Ctor: no loops are compiled
+     * @param [in] size  The number of IR instructions
+     */
+    explicit NativeLoopTable(std::size_t size) :
+      backEdgeCounts(size, 0),
+      loops(size, NULL),
+      generators()
+    {}
+
+    /*!
+     * @brief Dtor: return the native code buffers to the pool
+     */
+    ~NativeLoopTable()
+    {
+      for (std::vector<Xbyak::CodeGenerator*>::iterator itr = generators.begin(); itr != generators.end(); ++itr) {
+        delete *itr;
+      }
+    }
+
+    /*!
+     * @brief Count a taken back edge
+     * @param [in] pc  Index of the instruction which closes the loop
+     * @return True if the loop has just become hot, otherwise false
+     */
+    bool
+    countBackEdge(std::size_t pc) BRAINFUCK_NOEXCEPT
+    {
+      return ++backEdgeCounts[pc] == kHotLoopThreshold;
+    }
+
+    /*!
+     * @brief Get the native code of a loop
+     * @param [in] pc  Index of kLoopStart of the loop
+     * @return The native code, or NULL if the loop is not compiled
+     */
+    NativeLoop
+    get(std::size_t pc) const BRAINFUCK_NOEXCEPT
+    {
+      return loops[pc];
+    }
+
+    /*!
+     * @brief Take the native code of a loop
+     * @param [in] pc   Index of kLoopStart of the loop
+     * @param [in] gen  Generator which holds the ready native code of the loop
+     */
+    void
+    add(std::size_t pc, Xbyak::CodeGenerator* gen)
+    {
+      generators.push_back(gen);
+      loops[pc] = reinterpret_cast<NativeLoop>(const_cast<Xbyak::uint8*>(gen->getCode()));
+    }
+
+    /*!
+     * @brief Check whether an address is in the native code of a loop
+     * @param [in] address  Address
+     * @return True if the address is in the native code, otherwise false
+     */
+    bool
+    contains(const Xbyak::uint8* address) const BRAINFUCK_NOEXCEPT
+    {
+      for (std::vector<Xbyak::CodeGenerator*>::const_iterator itr = generators.begin(); itr != generators.end(); ++itr) {
+        if ((*itr)->getCode() <= address && address < (*itr)->getCode() + (*itr)->getSize()) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+  private:
+    //! Taken back edges of each loop
+    std::vector<unsigned int> backEdgeCounts;
+    //! Native code of each loop
+    std::vector<NativeLoop> loops;
+    //! Generators which own the native code
+    std::vector<Xbyak::CodeGenerator*> generators;
+
+    NativeLoopTable(const NativeLoopTable&);
+    NativeLoopTable&
+    operator=(const NativeLoopTable&);
+  };  // class NativeLoopTable
+
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+  //! Type alias for std::int8_t
+  typedef std::int8_t i8;
+  //! Type alias for std::int16_t
+  typedef std::int16_t i16;
+  //! Type alias for std::int32_t
+  typedef std::int32_t i32;
+#else
+  //! Type alias for std::int8_t
+  typedef int8_t i8;
+  //! Type alias for std::int16_t
+  typedef int16_t i16;
+  //! Type alias for std::int32_t
+  typedef int32_t i32;
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+
+  //! Number of bits for instruction type in an opcode of packed IR code
+  static const int kPackedTypeBits = 5;
+  //! Operand widths in an opcode of packed IR code, which are enumerators
+  //! so that they can be passed by reference without a definition
+  enum
+  {
+    //! 8-bit
+    kPackedWidth8 = 0,
+    //! 16-bit
+    kPackedWidth16 = 1,
+    //! 32-bit (escape form)
+    kPackedWidth32 = 2
+  };
+
   //! Default eap size
   static const std::size_t kDefaultHeapSize = 65536;
-  //! Default code generator size
-  static const std::size_t kDefaultXbyakCodeGeneratorSize = 1048576;
+  //! Minimum size of the native code buffer
+  static const std::size_t kMinXbyakCodeGeneratorSize = 4096;
+  //! Upper bound of the size of the native code outside IR instructions:
+  //! the prologue, the epilogue and the subroutine which flushes the output
+  static const std::size_t kMaxNativeFrameCodeSize = 512;
+  //! The number of taken back edges after which tiered execution compiles a
+  //! loop to native code
+  static const unsigned int kHotLoopThreshold = 1000;
+  //! The number of instructions and loops listed in the profile report
+  static const std::size_t kProfileReportSize = 20;
+  //! Maximum number of brainfuck commands of a source snippet in the profile
+  //! report
+  static const std::size_t kProfileSnippetSize = 40;
+  //! Size of the output buffer of native code
+  static const int kJitOutputBufferSize = 8192;
+  //! Default step budget of compile-time execution
+  static const std::size_t kDefaultEvalStepLimit = 1000000;
+  //! Default memory budget of compile-time execution
+  static const std::size_t kDefaultEvalMemoryLimit = 65536;
   //! Brainfuck source code
   std::string bfSource;
   //! IR code
   std::vector<BfInst> ircode;
-  //! Native code generator
-  Xbyak::CodeGenerator cg;
+  //! Source ranges of the IR instructions
+  std::vector<SourceRange> sourceRanges;
+  //! Packed IR code
+  std::vector<unsigned char> packedIRCode;
+  //! Native code generator, which is created by compileToNative()
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+  std::unique_ptr<Xbyak::CodeGenerator> cg;
+#else
+  std::auto_ptr<Xbyak::CodeGenerator> cg;
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+  //! Native code mapped from the on-disk cache, which is used instead of cg
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+  std::unique_ptr<JitCache> cachedCode;
+#else
+  std::auto_ptr<JitCache> cachedCode;
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+  //! Hot loops of tiered execution, which is created by compile()
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+  std::unique_ptr<NativeLoopTable> nativeLoops;
+#else
+  std::auto_ptr<NativeLoopTable> nativeLoops;
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+  //! Directory of the on-disk cache of native code (empty if disabled)
+  std::string jitCacheDirectory;
+  //! Version of the program, which is a part of the keys of the cache
+  std::string jitCacheVersion;
   //! Internal compile state
   CompileType state;
+  //! Dispatch method of IR code interpreter
+  DispatchType dispatchType;
+  //! Output of the prefix of IR code executed at compile time
+  std::string prefixOutput;
+  //! Step budget of compile-time execution
+  std::size_t evalStepLimit;
+  //! Memory budget of compile-time execution
+  std::size_t evalMemoryLimit;
+  //! Sink of the output of the program
+  OutputSink* outputSink;
+  //! Whether cells at negative indices are available
+  bool isBidirectionalTape;
+  //! Width of a cell in bits: 8, 16, 32 or 64
+  int cellBits;
+  //! Whether the heap and the native code buffer are backed by huge pages
+  bool useHugePages;
+  //! Whether ircode is loaded from an IR file instead of compiled from bfSource
+  bool isIRLoaded;
+  //! Whether execution of IR code counts executions of each instruction
+  bool isProfiled;
+  //! Execution counts of IR instructions of the last profiled execution
+  std::vector<std::uint64_t> profileCounts;
+  //! Output which native code had in its output buffer on tape overflow
+  std::vector<unsigned char> stagedJitOutput;
+  //! Size of the output in stagedJitOutput
+  std::size_t stagedJitOutputSize;
+  //! Threaded code of executeIRThreaded(), which is not in its frame because
+  //! a tape overflow jumps out of the frame without destructing it
+  std::vector<ThreadedInst> threadedCode;
 
   /*!
    * @brief Compress value or pointer movement operation
@@ -278,6 +948,19 @@ private:
     return endPos - curPos;
   }
 
+  /*!
+   * @brief Read one byte from the standard input, flushing the output sink
+   *        first if the read may block
+   * @return The byte, or EOF at the end of the input
+   */
+  int
+  readInput() const BRAINFUCK_NOEXCEPT
+  {
+    InputReader& input = InputReader::getStdin();
+    outputSink->flushBeforeInput(input.isFlushNeeded());
+    return input.get();
+  }
+
   /*!
    * @brief Convert label to string
    * @param [in] labelNo  Label Number
@@ -290,609 +973,3582 @@ private:
     return Xbyak::Label::toStr(labelNo) + (dir == XbyakDirection::B ? 'B' : 'F');
   }
 
-  template<
-    int kRW,
-    int kLocality
-  >
-#ifdef __GNUC__
-  __attribute__((const))
-#endif  // __GNUC__
-  static inline void
-  prefetch(const void* addr, std::size_t size=sizeof(void*) * 8, std::size_t stride=sizeof(void*) * 8)
+  /*!
+   * @brief Emit native code which moves the pointer
+   * @param [in] stack  Pointer register
+   * @param [in] value  Amount of movement
+   */
+  void
+  emitNativeMovePointer(const Xbyak::Reg& stack, int value)
   {
-#ifdef __GNUC__
-    for (const unsigned char* p = static_cast<const unsigned char*>(addr), *end = static_cast<const unsigned char*>(addr) + size; p < end; p += stride)
-    {
-      __builtin_prefetch(p, kRW, kLocality);
+    value *= cellBits / 8;
+    if (value > 0) {
+      if (value == 1) {
+        cg->inc(stack);
+      } else {
+        cg->add(stack, value);
+      }
+    } else if (value < 0) {
+      if (value == -1) {
+        cg->dec(stack);
+      } else {
+        cg->sub(stack, -value);
+      }
     }
-#endif  // __GNUC__
   }
 
-
-public:
   /*!
-   * Empty ctor
+   * @brief Emit native code of kSearchZero
+   *
+   * Strides of 1, 2 and 4 in both directions are searched by comparing
+   * aligned blocks with zero: 32 bytes with AVX2, or 16 bytes with SSE2,
+   * whichever the CPU supports at JIT time.
+   * pmovmskb gives one bit per byte, and the bits which are behind the start
+   * or not on the stride are masked out before a bit scan.
+   * The first block is the one which contains the current cell, so the loads
+   * never cross a page boundary beyond the zero cell.
+   * Cells wider than 8 bits are searched one by one.
+   * @param [in]     stack    Pointer register
+   * @param [in]     stride   Stride of the search
+   * @param [in,out] labelNo  Next label number
    */
-  Brainfuck() BRAINFUCK_NOEXCEPT :
-    bfSource(""),
-    ircode(),
-    cg(kDefaultXbyakCodeGeneratorSize),
-    state(CompileType::kUnknown)
-  {}
+  void
+  emitNativeSearchZero(const Xbyak::Reg& stack, int stride, int& labelNo)
+  {
+    int width = getNativeBlockWidth();
+    int step = stride > 0 ? stride : -stride;
+    if (cellBits != 8 || width == 0 || (step != 1 && step != 2 && step != 4)) {
+      // kLoopStart
+      cg->L(toXbyakLabelString(labelNo, XbyakDirection::B));
+      cg->mov(getCellAccumulator(), getCellFrame()[stack]);
+      cg->test(getCellAccumulator(), getCellAccumulator());
+      cg->jz(toXbyakLabelString(labelNo, XbyakDirection::F), Xbyak::CodeGenerator::T_NEAR);
+      // kNextN / kPrevN
+      emitNativeMovePointer(stack, stride);
+      // kLoopEnd
+      cg->jmp(toXbyakLabelString(labelNo, XbyakDirection::B));
+      cg->L(toXbyakLabelString(labelNo, XbyakDirection::F));
+      labelNo++;
+      return;
+    }
+#ifdef XBYAK32
+    const Xbyak::Reg32& block(cg->edx);
+    const Xbyak::Reg32& index(cg->eax);
+#else
+    const Xbyak::Reg64& block(cg->rdx);
+    const Xbyak::Reg64& index(cg->rax);
+#endif  // XBYAK32
+    // Bits of the stride from the lowest bit, and from the highest bit
+    const Xbyak::uint32 forwardPattern = step == 1 ? 0xffffffff : step == 2 ? 0x55555555 : 0x11111111;
+    const Xbyak::uint32 backwardPattern = step == 1 ? 0xffffffff : step == 2 ? 0xaaaaaaaa : 0x88888888;
+    const std::string loopLabel = toXbyakLabelString(labelNo, XbyakDirection::B);
+    const std::string endLabel = toXbyakLabelString(labelNo, XbyakDirection::F);
+    const std::string firstBlockLabel = toXbyakLabelString(labelNo + 1, XbyakDirection::F);
+    labelNo += 2;
+
+    cg->cmp(Xbyak::util::byte[stack], 0);
+    cg->jz(endLabel, Xbyak::CodeGenerator::T_NEAR);
+    cg->mov(block, stack);
+    cg->mov(cg->ecx, cg->edx);
+    cg->and_(block, -width);
+    cg->and_(cg->ecx, width - 1);
+    emitNativeCompareBlock(width, true);
+    if (stride > 0) {
+      // Drop the bytes before the current cell
+      cg->shr(cg->eax, cg->cl);
+      if (step == 1) {
+        cg->test(cg->eax, cg->eax);
+      } else {
+        cg->and_(cg->eax, forwardPattern);
+      }
+      cg->jnz(firstBlockLabel, Xbyak::CodeGenerator::T_NEAR);
+    } else {
+      // Drop the bytes after the current cell
+      cg->xor_(cg->ecx, 31);
+      cg->shl(cg->eax, cg->cl);
+      if (step == 1) {
+        cg->test(cg->eax, cg->eax);
+      } else {
+        cg->and_(cg->eax, backwardPattern);
+      }
+      cg->jnz(firstBlockLabel, Xbyak::CodeGenerator::T_NEAR);
+      cg->not_(cg->ecx);
+    }
+    if (step != 1) {
+      // Mask of the bytes on the stride in the following blocks
+      cg->and_(cg->ecx, step - 1);
+      cg->mov(cg->eax, forwardPattern);
+      cg->shl(cg->eax, cg->cl);
+      cg->mov(cg->ecx, cg->eax);
+    }
+    cg->L(loopLabel);
+    if (stride > 0) {
+      cg->add(block, width);
+    } else {
+      cg->sub(block, width);
+    }
+    emitNativeCompareBlock(width, false);
+    if (step == 1) {
+      cg->test(cg->eax, cg->eax);
+    } else {
+      cg->and_(cg->eax, cg->ecx);
+    }
+    cg->jz(loopLabel, Xbyak::CodeGenerator::T_NEAR);
+    if (stride > 0) {
+      cg->bsf(cg->eax, cg->eax);
+    } else {
+      cg->bsr(cg->eax, cg->eax);
+    }
+    cg->add(block, index);
+    cg->mov(stack, block);
+    if (width == 32) {
+      cg->vzeroupper();
+    }
+    cg->jmp(endLabel, Xbyak::CodeGenerator::T_NEAR);
+    cg->L(firstBlockLabel);
+    if (stride > 0) {
+      cg->bsf(cg->eax, cg->eax);
+      cg->add(stack, index);
+    } else {
+      // The highest bit is the current cell
+      cg->bsr(cg->eax, cg->eax);
+      cg->add(stack, index);
+      cg->sub(stack, 31);
+    }
+    if (width == 32) {
+      cg->vzeroupper();
+    }
+    cg->L(endLabel);
+  }
 
   /*!
-   * Copy-ctor
+   * @brief Get the block size of kSearchZero in native code
+   * @return 32 with AVX2, 16 with SSE2, otherwise 0
    */
-  Brainfuck(const Brainfuck& that) BRAINFUCK_NOEXCEPT :
-    bfSource(that.bfSource),
-    ircode(that.ircode),
-    cg(kDefaultXbyakCodeGeneratorSize),
-    state(CompileType::kUnknown)
-  {}
+  static int
+  getNativeBlockWidth() BRAINFUCK_NOEXCEPT
+  {
+    static const Xbyak::util::Cpu kCpu;
+    return kCpu.has(Xbyak::util::Cpu::tAVX2) ? 32 : kCpu.has(Xbyak::util::Cpu::tSSE2) ? 16 : 0;
+  }
 
   /*!
-   * @brief Copy operator @code operator= @endcode
-   * @param [in] that  Another Brainfuck object
-   * @return This Brainfuck object
+   * @brief Emit native code which sets eax to the mask of zero bytes in the
+   *        aligned block pointed by edx or rdx
+   * @param [in] width      Block size: 16 (SSE2) or 32 (AVX2)
+   * @param [in] isFirst    True for the first block, which clears the zero
+   *                        register
    */
-  Brainfuck&
-  operator=(const Brainfuck& that) BRAINFUCK_NOEXCEPT
+  void
+  emitNativeCompareBlock(int width, bool isFirst)
   {
-    bfSource = that.bfSource;
-    ircode = that.ircode;
-    state = that.state;
-    return *this;
+#ifdef XBYAK32
+    const Xbyak::Reg32& block(cg->edx);
+#else
+    const Xbyak::Reg64& block(cg->rdx);
+#endif  // XBYAK32
+    if (width == 32) {
+      if (isFirst) {
+        cg->vpxor(cg->ymm0, cg->ymm0, cg->ymm0);
+      }
+      cg->vpcmpeqb(cg->ymm1, cg->ymm0, Xbyak::util::yword[block]);
+      cg->vpmovmskb(cg->eax, cg->ymm1);
+    } else {
+      if (isFirst) {
+        cg->pxor(cg->xmm0, cg->xmm0);
+      }
+      cg->movdqa(cg->xmm1, Xbyak::util::xword[block]);
+      cg->pcmpeqb(cg->xmm1, cg->xmm0);
+      cg->pmovmskb(cg->eax, cg->xmm1);
+    }
   }
 
+  /*!
+   * @brief Emit native code which adds a value to a cell
+   * @param [in] cur    Address of the cell or register which holds the cell
+   * @param [in] value  Value to add
+   */
+  void
+  emitNativeAdd(const Xbyak::Operand& cur, int value)
+  {
+    value = toCellValue(static_cast<std::uint64_t>(value));
+    if (value > 0) {
+      if (value == 1) {
+        cg->inc(cur);
+      } else {
+        cg->add(cur, value);
+      }
+    } else if (value < 0) {
+      if (value == -1) {
+        cg->dec(cur);
+      } else {
+        cg->sub(cur, -value);
+      }
+    }
+  }
 
-#if __cplusplus >= 201103L || (defined(_MSC_VER) && (_MSC_VER > 1800 || _MSC_FULL_VER == 180021114))
-  // move-ctor
-  Brainfuck(Brainfuck&&) = default;
-  // move-operator=
-  Brainfuck&
-  operator=(Brainfuck&&) = default;
-#endif  // __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1700)
+  /*!
+   * @brief Emit native code which appends a character to the output buffer
+   *
+   * The buffer is passed to the output sink when it becomes full, and also at
+   * a newline if the sink flushes at every newline.
+   * @param [in]     outCur      Address of the next byte in the output buffer
+   * @param [in]     outIndex    Index register of the output buffer
+   * @param [in]     value       8-bit register which holds the character
+   * @param [in]     flushLabel  Label of the subroutine which flushes the
+   *                             buffer
+   * @param [in,out] labelNo     Next label number
+   */
+  void
+  emitNativePutchar(const Xbyak::Address& outCur, const Xbyak::Reg& outIndex, const Xbyak::Reg& value,
+      const Xbyak::Label& flushLabel, int& labelNo)
+  {
+    cg->mov(outCur, value);
+    cg->inc(outIndex);
+    cg->jnz(toXbyakLabelString(labelNo, XbyakDirection::F));
+    cg->call(flushLabel);
+    cg->L(toXbyakLabelString(labelNo, XbyakDirection::F));
+    labelNo++;
+    if (outputSink->getFlushPolicy() == OutputSink::FlushPolicy::kLine) {
+      cg->cmp(value, '\n');
+      cg->jne(toXbyakLabelString(labelNo, XbyakDirection::F));
+      cg->call(flushLabel);
+      cg->L(toXbyakLabelString(labelNo, XbyakDirection::F));
+      labelNo++;
+    }
+  }
 
   /*!
-   * @brief Load brainfuck source from a file
-   * @param [in] filename  Brainfuck source file name
+   * @brief Get the index of the cell width: 0, 1, 2 and 3 for 8, 16, 32 and
+   *        64 bits
+   * @param [in] bits  Width in bits
+   * @return Index of the width
+   */
+  static int
+  getWidthIndex(int bits) BRAINFUCK_NOEXCEPT
+  {
+    return bits == 8 ? 0 : bits == 16 ? 1 : bits == 32 ? 2 : 3;
+  }
+
+  /*!
+   * @brief Get the address frame of a cell in native code
+   * @return byte, word, dword or qword
+   */
+  const Xbyak::AddressFrame&
+  getCellFrame() const BRAINFUCK_NOEXCEPT
+  {
+    const Xbyak::AddressFrame* const frames[] = {
+      &Xbyak::util::byte, &Xbyak::util::word, &Xbyak::util::dword, &Xbyak::util::qword
+    };
+    return *frames[getWidthIndex(cellBits)];
+  }
+
+  /*!
+   * @brief Get the accumulator register of the cell width, which the native
+   *        code uses as a scratch register
+   * @return al, ax, eax or rax
+   */
+  const Xbyak::Reg&
+  getCellAccumulator() const BRAINFUCK_NOEXCEPT
+  {
+#ifdef XBYAK32
+    const Xbyak::Reg* const registers[] = {&cg->al, &cg->ax, &cg->eax};
+#else
+    const Xbyak::Reg* const registers[] = {&cg->al, &cg->ax, &cg->eax, &cg->rax};
+#endif  // XBYAK32
+    return *registers[getWidthIndex(cellBits)];
+  }
+
+  /*!
+   * @brief Get a register which holds cells in native code
+   * @param [in] index  Index of the register
+   * @return The register of the cell width
+   */
+  const Xbyak::Reg&
+  getCellRegister(int index) const BRAINFUCK_NOEXCEPT
+  {
+    return getCellRegister(index, cellBits);
+  }
+
+  /*!
+   * @brief Get a register which holds cells in native code
+   * @param [in] index  Index of the register
+   * @param [in] bits   Width of the register in bits, which is cellBits or 8
+   *                    for the low byte of the cell
+   * @return The register
+   */
+  const Xbyak::Reg&
+  getCellRegister(int index, int bits) const BRAINFUCK_NOEXCEPT
+  {
+    // Caller-saved registers which the other native code does not use
+#ifdef XBYAK32
+    const Xbyak::Reg* const registers[][kNCellRegisters] = {
+      {&cg->cl, &cg->dl},
+      {&cg->cx, &cg->dx},
+      {&cg->ecx, &cg->edx}
+    };
+#else
+    const Xbyak::Reg* const registers[][kNCellRegisters] = {
+      {&cg->cl, &cg->dl, &cg->r8b, &cg->r9b, &cg->r10b, &cg->r11b},
+      {&cg->cx, &cg->dx, &cg->r8w, &cg->r9w, &cg->r10w, &cg->r11w},
+      {&cg->ecx, &cg->edx, &cg->r8d, &cg->r9d, &cg->r10d, &cg->r11d},
+      {&cg->rcx, &cg->rdx, &cg->r8, &cg->r9, &cg->r10, &cg->r11}
+    };
+#endif  // XBYAK32
+    return *registers[getWidthIndex(bits)][index];
+  }
+
+  /*!
+   * @brief Assign a register to a cell, evicting the least recently used cell
+   *        if no register is free
+   * @param [in,out] cache       Cells held in registers
+   * @param [in]     stack       Pointer register
+   * @param [in]     offset      Offset of the cell from the pointer
+   * @param [in]     isLoaded    True if the value of the cell is needed
+   * @param [in]     keptOffset  Offset of the cell which must not be evicted
+   * @return Index of the register
+   */
+  int
+  emitNativeCacheCell(CellCache& cache, const Xbyak::Reg& stack, int offset, bool isLoaded, int keptOffset)
+  {
+    int index = -1;
+    for (int i = 0; i < kNCellRegisters; i++) {
+      if (cache.isUsed[i] && cache.offsets[i] == offset) {
+        cache.lastUses[i] = ++cache.clock;
+        return i;
+      }
+      if (cache.isUsed[i] && cache.offsets[i] == keptOffset) {
+        continue;
+      }
+      if (index == -1 || (!cache.isUsed[i] && cache.isUsed[index])
+          || (cache.isUsed[i] == cache.isUsed[index] && cache.lastUses[i] < cache.lastUses[index])) {
+        index = i;
+      }
+    }
+    if (cache.isUsed[index] && cache.isDirty[index]) {
+      cg->mov(getCellFrame()[stack + cache.offsets[index] * (cellBits / 8)], getCellRegister(index));
+    }
+    if (isLoaded) {
+      cg->mov(getCellRegister(index), getCellFrame()[stack + offset * (cellBits / 8)]);
+    }
+    cache.offsets[index] = offset;
+    cache.isUsed[index] = true;
+    cache.isDirty[index] = false;
+    cache.lastUses[index] = ++cache.clock;
+    return index;
+  }
+
+  /*!
+   * @brief Get a register which holds a cell to read
+   * @param [in,out] cache   Cells held in registers
+   * @param [in]     stack   Pointer register
+   * @param [in]     offset  Offset of the cell from the pointer
+   * @return The register
+   */
+  const Xbyak::Reg&
+  emitNativeReadCell(CellCache& cache, const Xbyak::Reg& stack, int offset)
+  {
+    return getCellRegister(emitNativeCacheCell(cache, stack, offset, true, offset));
+  }
+
+  /*!
+   * @brief Get a register which holds a cell to write
+   * @param [in,out] cache       Cells held in registers
+   * @param [in]     stack       Pointer register
+   * @param [in]     offset      Offset of the cell from the pointer
+   * @param [in]     isLoaded    True if the value of the cell is needed
+   * @param [in]     keptOffset  Offset of the cell which must not be evicted
+   * @return The register
+   */
+  const Xbyak::Reg&
+  emitNativeWriteCell(CellCache& cache, const Xbyak::Reg& stack, int offset, bool isLoaded, int keptOffset)
+  {
+    int index = emitNativeCacheCell(cache, stack, offset, isLoaded, keptOffset);
+    cache.isDirty[index] = true;
+    return getCellRegister(index);
+  }
+
+  /*!
+   * @brief Find a register which holds a cell
+   * @param [in] cache   Cells held in registers
+   * @param [in] offset  Offset of the cell from the pointer
+   * @return Index of the register, or -1 if the cell is not held
+   */
+  static int
+  findCachedCell(const CellCache& cache, int offset) BRAINFUCK_NOEXCEPT
+  {
+    for (int i = 0; i < kNCellRegisters; i++) {
+      if (cache.isUsed[i] && cache.offsets[i] == offset) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  /*!
+   * @brief Emit native code which writes back the cells held in registers,
+   *        and forget them
+   *
+   * This is needed before labels, jumps and calls, where the registers may
+   * hold other values.
+   * @param [in,out] cache  Cells held in registers
+   * @param [in]     stack  Pointer register
    */
   void
-  load(const std::string& filename)
+  emitNativeFlushCells(CellCache& cache, const Xbyak::Reg& stack)
   {
-    std::ifstream ifs(filename.c_str());
-    if (!ifs.is_open()) {
-      throw std::runtime_error("Failed to open: " + filename);
+    for (int i = 0; i < kNCellRegisters; i++) {
+      if (cache.isUsed[i] && cache.isDirty[i]) {
+        cg->mov(getCellFrame()[stack + cache.offsets[i] * (cellBits / 8)], getCellRegister(i));
+      }
+      cache.isUsed[i] = false;
+      cache.isDirty[i] = false;
     }
-    load(ifs);
   }
 
   /*!
-   * @brief Load brainfuck source from a std::istream
-   * @param [in,out] is  std::istream of brainfuck source code
+   * @brief Emit native code which moves the pointer, keeping the cells held in
+   *        registers
+   * @param [in,out] cache  Cells held in registers
+   * @param [in]     stack  Pointer register
+   * @param [in]     value  Amount of movement
    */
   void
-  load(std::istream& is) BRAINFUCK_NOEXCEPT
+  emitNativeMovePointer(CellCache& cache, const Xbyak::Reg& stack, int value)
   {
-    state = CompileType::kUnknown;
-    std::streamoff streamSize = getStreamSize(is);
-    if (streamSize == -1) {
-      bfSource = std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    emitNativeMovePointer(stack, value);
+    for (int i = 0; i < kNCellRegisters; i++) {
+      cache.offsets[i] -= value;
+    }
+  }
+
+  /*!
+   * @brief Check whether an instruction jumps to another IR instruction
+   * @param [in] type  Instruction type
+   * @return True if the instruction is a jump instruction, otherwise false
+   */
+  static bool
+  isJumpInstruction(BfInst::Type type) BRAINFUCK_NOEXCEPT
+  {
+    switch (type) {
+      case BfInst::Type::kLoopStart:
+      case BfInst::Type::kLoopEnd:
+      case BfInst::Type::kIf:
+      case BfInst::Type::kMovePointerIf:
+      case BfInst::Type::kMovePointerLoopEnd:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  /*!
+   * @brief Get the number of operands of an instruction in packed IR code
+   * @param [in] type  Instruction type
+   * @return The number of operands
+   */
+  static int
+  getPackedOperandCount(BfInst::Type type) BRAINFUCK_NOEXCEPT
+  {
+    switch (type) {
+      case BfInst::Type::kMovePointer:
+      case BfInst::Type::kPutchar:
+      case BfInst::Type::kGetchar:
+      case BfInst::Type::kLoopStart:
+      case BfInst::Type::kLoopEnd:
+      case BfInst::Type::kIf:
+      case BfInst::Type::kSearchZero:
+      case BfInst::Type::kAddVar:
+      case BfInst::Type::kSubVar:
+        return 1;
+      case BfInst::Type::kAdd:
+      case BfInst::Type::kAssign:
+      case BfInst::Type::kAddCMulVar:
+      case BfInst::Type::kAddVarFrom:
+      case BfInst::Type::kSubVarFrom:
+      case BfInst::Type::kMovePointerAdd:
+      case BfInst::Type::kAddMovePointer:
+      case BfInst::Type::kMovePointerAssign:
+      case BfInst::Type::kAssignMovePointer:
+      case BfInst::Type::kMovePointerIf:
+      case BfInst::Type::kMovePointerLoopEnd:
+        return 2;
+      default:
+        return 0;
+    }
+  }
+
+  /*!
+   * @brief Get the minimum operand width to hold a value in packed IR code
+   * @param [in] value  Operand value
+   * @return Operand width
+   */
+  static int
+  getPackedWidth(int value) BRAINFUCK_NOEXCEPT
+  {
+    if (-128 <= value && value <= 127) {
+      return kPackedWidth8;
+    } else if (-32768 <= value && value <= 32767) {
+      return kPackedWidth16;
     } else {
-      bfSource.resize(streamSize);
-      is.read(&bfSource[0], bfSource.length());
+      return kPackedWidth32;
     }
   }
 
   /*!
-   * @brief Load brainfuck source from a std::string
-   * @param [in] bfSource_  Brainfuck source code
+   * @brief Get byte size of an instruction in packed IR code
+   * @param [in] type   Instruction type
+   * @param [in] width  Operand width
+   * @return Byte size of the instruction
    */
-  void
-  loadSource(const std::string& bfSource_) BRAINFUCK_NOEXCEPT
+  static std::size_t
+  getPackedInstSize(BfInst::Type type, int width) BRAINFUCK_NOEXCEPT
   {
-    bfSource = bfSource_;
-    state = CompileType::kUnknown;
+    if (type == BfInst::Type::kEndIf) {
+      return 0;
+    }
+    return 1 + static_cast<std::size_t>(getPackedOperandCount(type) << width);
   }
 
   /*!
-   * @brief Remove extra character from the source code
+   * @brief Append an operand to packed IR code
+   * @param [in] value  Operand value
+   * @param [in] width  Operand width
    */
   void
-  trim() BRAINFUCK_NOEXCEPT
+  appendPackedOperand(int value, int width) BRAINFUCK_NOEXCEPT
   {
-#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
-    static const std::string kBrainfuckCharacters = "+-><.,[]";
-    bfSource.erase(
-      std::remove_if(
-        std::begin(bfSource),
-        std::end(bfSource),
-        [&](const decltype(kBrainfuckCharacters)::value_type& ch) {
-          return kBrainfuckCharacters.find_first_of(ch) == std::string::npos;
-        }),
-      std::end(bfSource));
+    unsigned char buf[sizeof(i32)];
+    std::size_t size = static_cast<std::size_t>(1) << width;
+    switch (width) {
+      case kPackedWidth8:
+        {
+          i8 v = static_cast<i8>(value);
+          std::memcpy(buf, &v, sizeof(v));
+        }
+        break;
+      case kPackedWidth16:
+        {
+          i16 v = static_cast<i16>(value);
+          std::memcpy(buf, &v, sizeof(v));
+        }
+        break;
+      default:
+        {
+          i32 v = value;
+          std::memcpy(buf, &v, sizeof(v));
+        }
+        break;
+    }
+    packedIRCode.insert(packedIRCode.end(), buf, buf + size);
+  }
+
+  /*!
+   * @brief Fetch an operand from packed IR code
+   * @tparam T  Operand type
+   * @param [in,out] ip  Pointer to the operand, which is advanced to the next
+   *                     operand or instruction
+   * @return Operand value
+   */
+  template<typename T>
+  static inline int
+  fetchPackedOperand(const unsigned char*& ip) BRAINFUCK_NOEXCEPT
+  {
+    T value;
+    std::memcpy(&value, ip, sizeof(value));
+    ip += sizeof(value);
+    return value;
+  }
+
+  /*!
+   * @brief Raise break point
+   */
+  static inline void
+  debugBreak() BRAINFUCK_NOEXCEPT
+  {
+#if defined(_MSC_VER)
+    __debugbreak();
+#elif defined(__i386__) || defined(__x86_64__)
+    __asm__ volatile("int $0x03");
+#elif defined(__thumb__)
+    __asm__ volatile(".inst 0xde01");
+#elif defined(__arm__) && !defined(__thumb__)
+    __asm__ volatile(".inst 0xe7f001f0");
+#elif defined(__aarch64__) && defined(__APPLE__)
+    __builtin_trap();
+#elif defined(__aarch64__)
+    __asm__ volatile(".inst 0xd4200000");
+#elif defined(_WIN32)
+    __builtin_trap();
 #else
-    bfSource.erase(
-      std::remove_if(
-        bfSource.begin(),
-        bfSource.end(),
-        IsBrainfuckCharacter()),
-      bfSource.end());
-#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+    std::raise(SIGTRAP);
+#endif  // defined(MSC_VER)
+  }
+
+  template<
+    int kRW,
+    int kLocality
+  >
+#ifdef __GNUC__
+  __attribute__((const))
+#endif  // __GNUC__
+  static inline void
+  prefetch(const void* addr, std::size_t size=sizeof(void*) * 8, std::size_t stride=sizeof(void*) * 8)
+  {
+#ifdef __GNUC__
+    for (const unsigned char* p = static_cast<const unsigned char*>(addr), *end = static_cast<const unsigned char*>(addr) + size; p < end; p += stride)
+    {
+      __builtin_prefetch(p, kRW, kLocality);
+    }
+#endif  // __GNUC__
+  }
+
+  /*!
+   * @brief Add a cell multiplied by a constant to another cell
+   * @tparam CellT  Cell type
+   * @param [in] dst          Value of the destination cell
+   * @param [in] src          Value of the source cell
+   * @param [in] coefficient  Coefficient
+   * @return dst + src * coefficient modulo the range of CellT
+   */
+  template<typename CellT>
+  static inline CellT
+  mulAddCell(CellT dst, CellT src, int coefficient) BRAINFUCK_NOEXCEPT
+  {
+    // Multiply in unsigned int or a wider type, where the product of narrow
+    // cells wraps around instead of overflowing int
+    return static_cast<CellT>(dst + (0U + src) * static_cast<CellT>(coefficient));
+  }
+
+  /*!
+   * @brief Search the nearest zero cell which the pointer reaches with
+   *        kSearchZero on a tape of cells wider than a byte
+   * @tparam CellT  Cell type
+   * @param [in] p       Current pointer
+   * @param [in] stride  Stride of the search
+   * @return Pointer to the zero cell
+   */
+  template<typename CellT>
+  static CellT*
+  searchZero(CellT* p, int stride) BRAINFUCK_NOEXCEPT
+  {
+    while (*p != 0) {
+      p += stride;
+    }
+    return p;
+  }
+
+  /*!
+   * @brief Search the nearest zero cell which the pointer reaches with
+   *        kSearchZero
+   *
+   * Strides of 1, 2 and 4 in both directions are searched with SIMD
+   * comparison of aligned blocks: AVX2 if the CPU supports it, otherwise SSE2,
+   * or 64-bit integer operations on the other architectures.
+   * Bytes of a block which are not on the stride are masked out.
+   * Aligned loads never cross a page boundary, so they never fault where the
+   * byte-by-byte search would not.
+   * @param [in] p       Current pointer
+   * @param [in] stride  Stride of the search
+   * @return Pointer to the zero cell
+   */
+  static unsigned char*
+  searchZero(unsigned char* p, int stride) BRAINFUCK_NOEXCEPT
+  {
+    if (*p == 0) {
+      return p;
+    }
+    switch (stride) {
+      case 1:
+      case 2:
+      case 4:
+#if defined(BRAINFUCK_AVX2_AVAILABLE)
+        if (hasAvx2()) {
+          return searchZeroForwardAvx2(p, getLaneMask(p, stride));
+        }
+        return searchZeroForwardSse2(p, getLaneMask(p, stride));
+#elif defined(BRAINFUCK_SSE2_AVAILABLE)
+        return searchZeroForwardSse2(p, getLaneMask(p, stride));
+#elif defined(BRAINFUCK_SWAR_AVAILABLE)
+        return searchZeroForwardSwar(p, getLaneMask(p, stride));
+#else
+        break;
+#endif  // defined(BRAINFUCK_AVX2_AVAILABLE)
+      case -1:
+      case -2:
+      case -4:
+#if defined(BRAINFUCK_AVX2_AVAILABLE)
+        if (hasAvx2()) {
+          return searchZeroBackwardAvx2(p, getLaneMask(p, -stride));
+        }
+        return searchZeroBackwardSse2(p, getLaneMask(p, -stride));
+#elif defined(BRAINFUCK_SSE2_AVAILABLE)
+        return searchZeroBackwardSse2(p, getLaneMask(p, -stride));
+#elif defined(BRAINFUCK_SWAR_AVAILABLE)
+        return searchZeroBackwardSwar(p, getLaneMask(p, -stride));
+#else
+        break;
+#endif  // defined(BRAINFUCK_AVX2_AVAILABLE)
+    }
+    do {
+      p += stride;
+    } while (*p != 0);
+    return p;
+  }
+
+  /*!
+   * @brief Get the mask of bytes on the stride in an aligned block
+   *
+   * The mask has one bit per byte for SIMD comparison, or the most
+   * significant bit of each byte for 64-bit integer operations.
+   * @param [in] p       Pointer to a byte on the stride
+   * @param [in] stride  Absolute value of the stride: 1, 2 or 4
+   * @return The mask of bytes on the stride
+   */
+  static std::uint64_t
+  getLaneMask(const unsigned char* p, int stride) BRAINFUCK_NOEXCEPT
+  {
+#ifdef BRAINFUCK_SWAR_AVAILABLE
+    static const std::uint64_t kLaneMasks[] = {
+      0x0000000000000000ULL, 0x8080808080808080ULL, 0x0080008000800080ULL, 0x0000000000000000ULL,
+      0x0000008000000080ULL
+    };
+    return kLaneMasks[stride] << (8 * (reinterpret_cast<std::uintptr_t>(p) & static_cast<std::uintptr_t>(stride - 1)));
+#else
+    static const std::uint64_t kLaneMasks[] = {
+      0x00000000ULL, 0xffffffffULL, 0x55555555ULL, 0x00000000ULL,
+      0x11111111ULL
+    };
+    return kLaneMasks[stride] << (reinterpret_cast<std::uintptr_t>(p) & static_cast<std::uintptr_t>(stride - 1));
+#endif  // BRAINFUCK_SWAR_AVAILABLE
+  }
+
+  /*!
+   * @brief Align a pointer down
+   * @tparam kAlignment  Alignment
+   * @param [in] p  Pointer
+   * @return Aligned pointer
+   */
+  template<std::size_t kAlignment>
+  static unsigned char*
+  alignDown(unsigned char* p) BRAINFUCK_NOEXCEPT
+  {
+    return p - (reinterpret_cast<std::uintptr_t>(p) & (kAlignment - 1));
+  }
+
+  /*!
+   * @brief Get the index of the least significant set bit
+   * @param [in] x  Non-zero value
+   * @return The index of the least significant set bit
+   */
+  static inline int
+  getLowestBitIndex(std::uint64_t x) BRAINFUCK_NOEXCEPT
+  {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<int>(index);
+#else
+    int index = 0;
+    for (; (x & 1) == 0; x >>= 1) {
+      index++;
+    }
+    return index;
+#endif  // defined(__GNUC__)
+  }
+
+  /*!
+   * @brief Get the index of the most significant set bit
+   * @param [in] x  Non-zero value
+   * @return The index of the most significant set bit
+   */
+  static inline int
+  getHighestBitIndex(std::uint64_t x) BRAINFUCK_NOEXCEPT
+  {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(x);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return static_cast<int>(index);
+#else
+    int index = 0;
+    for (x >>= 1; x != 0; x >>= 1) {
+      index++;
+    }
+    return index;
+#endif  // defined(__GNUC__)
+  }
+
+#if defined(BRAINFUCK_SSE2_AVAILABLE)
+  static unsigned char*
+  searchZeroForwardSse2(unsigned char* p, std::uint64_t laneMask) BRAINFUCK_NOEXCEPT
+  {
+    const __m128i zero = _mm_setzero_si128();
+    unsigned char* q = alignDown<16>(p);
+    std::uint64_t mask = static_cast<std::uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(q)), zero)))
+      & laneMask & (~0ULL << (p - q));
+    while (mask == 0) {
+      q += 16;
+      mask = static_cast<std::uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(q)), zero))) & laneMask;
+    }
+    return q + getLowestBitIndex(mask);
+  }
+
+  static unsigned char*
+  searchZeroBackwardSse2(unsigned char* p, std::uint64_t laneMask) BRAINFUCK_NOEXCEPT
+  {
+    const __m128i zero = _mm_setzero_si128();
+    unsigned char* q = alignDown<16>(p);
+    std::uint64_t mask = static_cast<std::uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(q)), zero)))
+      & laneMask & ((2ULL << (p - q)) - 1);
+    while (mask == 0) {
+      q -= 16;
+      mask = static_cast<std::uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(q)), zero))) & laneMask;
+    }
+    return q + getHighestBitIndex(mask);
+  }
+#endif  // defined(BRAINFUCK_SSE2_AVAILABLE)
+
+#if defined(BRAINFUCK_AVX2_AVAILABLE)
+  /*!
+   * @brief Check whether the CPU and the OS support AVX2
+   * @return True if AVX2 is available, otherwise false
+   */
+  static bool
+  hasAvx2() BRAINFUCK_NOEXCEPT
+  {
+    static const bool kHasAvx2 = detectAvx2();
+    return kHasAvx2;
+  }
+
+  static bool
+  detectAvx2() BRAINFUCK_NOEXCEPT
+  {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+      return false;
+    }
+    __cpuid(info, 1);
+    // OSXSAVE and AVX
+    if ((info[2] & 0x18000000) != 0x18000000 || (_xgetbv(0) & 0x06) != 0x06) {
+      return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & 0x20) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif  // defined(_MSC_VER)
+  }
+
+#  if defined(__GNUC__)
+  __attribute__((target("avx2")))
+#  endif  // defined(__GNUC__)
+  static unsigned char*
+  searchZeroForwardAvx2(unsigned char* p, std::uint64_t laneMask) BRAINFUCK_NOEXCEPT
+  {
+    const __m256i zero = _mm256_setzero_si256();
+    unsigned char* q = alignDown<32>(p);
+    std::uint64_t mask = static_cast<std::uint64_t>(static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(reinterpret_cast<const __m256i*>(q)), zero))))
+      & laneMask & (~0ULL << (p - q));
+    while (mask == 0) {
+      q += 32;
+      mask = static_cast<std::uint64_t>(static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(reinterpret_cast<const __m256i*>(q)), zero)))) & laneMask;
+    }
+    return q + getLowestBitIndex(mask);
+  }
+
+#  if defined(__GNUC__)
+  __attribute__((target("avx2")))
+#  endif  // defined(__GNUC__)
+  static unsigned char*
+  searchZeroBackwardAvx2(unsigned char* p, std::uint64_t laneMask) BRAINFUCK_NOEXCEPT
+  {
+    const __m256i zero = _mm256_setzero_si256();
+    unsigned char* q = alignDown<32>(p);
+    std::uint64_t mask = static_cast<std::uint64_t>(static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(reinterpret_cast<const __m256i*>(q)), zero))))
+      & laneMask & ((2ULL << (p - q)) - 1);
+    while (mask == 0) {
+      q -= 32;
+      mask = static_cast<std::uint64_t>(static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(reinterpret_cast<const __m256i*>(q)), zero)))) & laneMask;
+    }
+    return q + getHighestBitIndex(mask);
+  }
+#endif  // defined(BRAINFUCK_AVX2_AVAILABLE)
+
+#if defined(BRAINFUCK_SWAR_AVAILABLE)
+  /*!
+   * @brief Get the most significant bits of zero bytes in a 64-bit word
+   * @param [in] p  Pointer to 8-byte aligned memory
+   * @return The most significant bit is set in each zero byte
+   */
+  static inline std::uint64_t
+  getZeroBytes(const unsigned char* p) BRAINFUCK_NOEXCEPT
+  {
+    std::uint64_t x;
+    std::memcpy(&x, p, sizeof(x));
+    return ~(((x & 0x7f7f7f7f7f7f7f7fULL) + 0x7f7f7f7f7f7f7f7fULL) | x | 0x7f7f7f7f7f7f7f7fULL);
+  }
+
+  static unsigned char*
+  searchZeroForwardSwar(unsigned char* p, std::uint64_t laneMask) BRAINFUCK_NOEXCEPT
+  {
+    unsigned char* q = alignDown<8>(p);
+    std::uint64_t mask = getZeroBytes(q) & laneMask & (~0ULL << (8 * (p - q)));
+    while (mask == 0) {
+      q += 8;
+      mask = getZeroBytes(q) & laneMask;
+    }
+    return q + getLowestBitIndex(mask) / 8;
+  }
+
+  static unsigned char*
+  searchZeroBackwardSwar(unsigned char* p, std::uint64_t laneMask) BRAINFUCK_NOEXCEPT
+  {
+    unsigned char* q = alignDown<8>(p);
+    std::uint64_t mask = getZeroBytes(q) & laneMask & (~0ULL >> (8 * (7 - (p - q))));
+    while (mask == 0) {
+      q -= 8;
+      mask = getZeroBytes(q) & laneMask;
+    }
+    return q + getHighestBitIndex(mask) / 8;
+  }
+#endif  // defined(BRAINFUCK_SWAR_AVAILABLE)
+
+
+public:
+  /*!
+   * @brief Ctor
+   * @param [in] useHugePages  Back the heap and the native code buffer with
+   *                           huge pages if available
+   */
+  explicit Brainfuck(bool useHugePages=false) BRAINFUCK_NOEXCEPT :
+    bfSource(""),
+    ircode(),
+    sourceRanges(),
+    packedIRCode(),
+    cg(),
+    cachedCode(),
+    nativeLoops(),
+    jitCacheDirectory(),
+    jitCacheVersion(),
+    state(CompileType::kUnknown),
+    dispatchType(DispatchType::kSwitch),
+    prefixOutput(),
+    evalStepLimit(kDefaultEvalStepLimit),
+    evalMemoryLimit(kDefaultEvalMemoryLimit),
+    outputSink(&OutputSink::getStdout()),
+    isBidirectionalTape(false),
+    cellBits(8),
+    useHugePages(useHugePages),
+    isIRLoaded(false),
+    isProfiled(false),
+    profileCounts(),
+    stagedJitOutput(),
+    stagedJitOutputSize(0),
+    threadedCode()
+  {}
+
+  /*!
+   * Copy-ctor
+   */
+  Brainfuck(const Brainfuck& that) BRAINFUCK_NOEXCEPT :
+    bfSource(that.bfSource),
+    ircode(that.ircode),
+    sourceRanges(that.sourceRanges),
+    packedIRCode(that.packedIRCode),
+    cg(),
+    cachedCode(),
+    nativeLoops(),
+    jitCacheDirectory(that.jitCacheDirectory),
+    jitCacheVersion(that.jitCacheVersion),
+    state(CompileType::kUnknown),
+    dispatchType(that.dispatchType),
+    prefixOutput(that.prefixOutput),
+    evalStepLimit(that.evalStepLimit),
+    evalMemoryLimit(that.evalMemoryLimit),
+    outputSink(that.outputSink),
+    isBidirectionalTape(that.isBidirectionalTape),
+    cellBits(that.cellBits),
+    useHugePages(that.useHugePages),
+    isIRLoaded(that.isIRLoaded),
+    isProfiled(that.isProfiled),
+    profileCounts(that.profileCounts),
+    stagedJitOutput(),
+    stagedJitOutputSize(0),
+    threadedCode()
+  {}
+
+  /*!
+   * @brief Copy operator @code operator= @endcode
+   * @param [in] that  Another Brainfuck object
+   * @return This Brainfuck object
+   */
+  Brainfuck&
+  operator=(const Brainfuck& that) BRAINFUCK_NOEXCEPT
+  {
+    bfSource = that.bfSource;
+    ircode = that.ircode;
+    sourceRanges = that.sourceRanges;
+    packedIRCode = that.packedIRCode;
+    // Native code is not copied
+    if (this != &that) {
+      cg.reset();
+      cachedCode.reset();
+      nativeLoops.reset();
+    }
+    jitCacheDirectory = that.jitCacheDirectory;
+    jitCacheVersion = that.jitCacheVersion;
+    state = that.state == CompileType::kJit || that.state == CompileType::kTiered ? CompileType::kUnknown : that.state;
+    dispatchType = that.dispatchType;
+    prefixOutput = that.prefixOutput;
+    evalStepLimit = that.evalStepLimit;
+    evalMemoryLimit = that.evalMemoryLimit;
+    outputSink = that.outputSink;
+    isBidirectionalTape = that.isBidirectionalTape;
+    cellBits = that.cellBits;
+    useHugePages = that.useHugePages;
+    isIRLoaded = that.isIRLoaded;
+    isProfiled = that.isProfiled;
+    profileCounts = that.profileCounts;
+    return *this;
+  }
+
+
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && (_MSC_VER > 1800 || _MSC_FULL_VER == 180021114))
+  // move-ctor
+  Brainfuck(Brainfuck&&) = default;
+  // move-operator=
+  Brainfuck&
+  operator=(Brainfuck&&) = default;
+#endif  // __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1700)
+
+  /*!
+   * @brief Load brainfuck source from a file
+   * @param [in] filename  Brainfuck source file name
+   */
+  void
+  load(const std::string& filename)
+  {
+    std::ifstream ifs(filename.c_str());
+    if (!ifs.is_open()) {
+      throw std::runtime_error("Failed to open: " + filename);
+    }
+    load(ifs);
+  }
+
+  /*!
+   * @brief Load brainfuck source from a std::istream
+   * @param [in,out] is  std::istream of brainfuck source code
+   */
+  void
+  load(std::istream& is) BRAINFUCK_NOEXCEPT
+  {
+    state = CompileType::kUnknown;
+    isIRLoaded = false;
+    sourceRanges.clear();
+    std::streamoff streamSize = getStreamSize(is);
+    if (streamSize == -1) {
+      bfSource = std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    } else {
+      bfSource.resize(streamSize);
+      is.read(&bfSource[0], bfSource.length());
+    }
+  }
+
+  /*!
+   * @brief Load brainfuck source from a std::string
+   * @param [in] bfSource_  Brainfuck source code
+   */
+  void
+  loadSource(const std::string& bfSource_) BRAINFUCK_NOEXCEPT
+  {
+    bfSource = bfSource_;
+    state = CompileType::kUnknown;
+    isIRLoaded = false;
+    sourceRanges.clear();
+  }
+
+  /*!
+   * @brief Load IR code from a .bfir file written by saveIR()
+   *
+   * The loaded IR code is already optimized, so compile() only packs it or
+   * translates it to native code, and emit() accepts it for every target.
+   * The width of a cell is taken from the file.
+   * Source offsets in the file are kept as empty source ranges, since the
+   * source code is not available.
+   * @param [in] filename  IR file name
+   */
+  void
+  loadIR(const std::string& filename)
+  {
+    IRFile irFile(filename);
+    std::vector<BfInst> code;
+    irFile.getInstructions(code);
+    if (!isValidIR(code)) {
+      throw std::runtime_error("Invalid IR file: " + filename);
+    }
+    std::vector<std::uint32_t> sourceOffsets;
+    irFile.getSourceOffsets(sourceOffsets);
+    sourceRanges.clear();
+    for (std::vector<std::uint32_t>::const_iterator itr = sourceOffsets.begin(); itr != sourceOffsets.end(); ++itr) {
+      sourceRanges.push_back(SourceRange(*itr, *itr));
+    }
+    ircode.swap(code);
+    prefixOutput = irFile.getPrefixOutput();
+    cellBits = irFile.getCellBits();
+    bfSource.clear();
+    packedIRCode.clear();
+    isIRLoaded = true;
+    state = CompileType::kIR;
+  }
+
+  /*!
+   * @brief Write IR code to a .bfir file
+   *
+   * Call compile() with CompileType::kIR before calling this function.
+   * The offset of the first source byte of each instruction is also written.
+   * @param [in] filename  IR file name
+   */
+  void
+  saveIR(const std::string& filename) const
+  {
+    std::vector<std::uint32_t> sourceOffsets;
+    if (sourceRanges.size() == ircode.size()) {
+      for (std::vector<SourceRange>::const_iterator itr = sourceRanges.begin(); itr != sourceRanges.end(); ++itr) {
+        sourceOffsets.push_back(static_cast<std::uint32_t>(itr->begin));
+      }
+    }
+    IRFile::save(filename, ircode, prefixOutput, cellBits, sourceOffsets);
+  }
+
+  /*!
+   * @brief Count executions of IR instructions in execute()
+   *
+   * This takes effect with CompileType::kIR and DispatchType::kSwitch.
+   * Call dumpProfile() after execute() to get the result.
+   * @param [in] isProfiled_  Whether executions are counted
+   */
+  void
+  setProfile(bool isProfiled_) BRAINFUCK_NOEXCEPT
+  {
+    isProfiled = isProfiled_;
+  }
+
+  /*!
+   * @brief Set dispatch method of IR code interpreter
+   * @param [in] dt  Dispatch method
+   */
+  void
+  setDispatchType(DispatchType dt) BRAINFUCK_NOEXCEPT
+  {
+    dispatchType = dt;
+  }
+
+  /*!
+   * @brief Set budgets of compile-time execution of the input-independent
+   *        prefix of the program
+   * @param [in] stepLimit    Maximum number of executed IR instructions
+   *                          (0 disables compile-time execution)
+   * @param [in] memoryLimit  Maximum number of cells
+   */
+  void
+  setEvalLimit(std::size_t stepLimit, std::size_t memoryLimit) BRAINFUCK_NOEXCEPT
+  {
+    evalStepLimit = stepLimit;
+    evalMemoryLimit = memoryLimit;
+  }
+
+  /*!
+   * @brief Set the sink of the output of the program
+   *
+   * Native code is compiled for the flush policy of the sink, so set the sink
+   * and its policy before compile().
+   * The sink is not owned by this object.
+   * @param [in] sink  Output sink (OutputSink::getStdout() by default)
+   */
+  void
+  setOutputSink(OutputSink& sink) BRAINFUCK_NOEXCEPT
+  {
+    outputSink = &sink;
+  }
+
+  /*!
+   * @brief Enable or disable the bidirectional tape
+   *
+   * With the bidirectional tape, the pointer starts in the middle of the heap
+   * and the same number of cells as the heap size are available at negative
+   * indices.
+   * This also applies to the code emitted for kC, kXbyakC, kElfX86 and
+   * kElfX64.
+   * @param [in] isBidirectional  True to enable the bidirectional tape
+   */
+  void
+  setBidirectionalTape(bool isBidirectional) BRAINFUCK_NOEXCEPT
+  {
+    isBidirectionalTape = isBidirectional;
+  }
+
+  /*!
+   * @brief Set the width of a cell
+   *
+   * Cells wrap around modulo 2^bits, and the optimizer folds arithmetic
+   * modulo 2^bits.
+   * '.' writes the lowest byte of a cell, and ',' stores a byte.
+   * Set the width before compile(), since IR code and native code depend on
+   * it.
+   * This also applies to the code emitted for kC, kXbyakC, kElfX86 (up to 32
+   * bits) and kElfX64.
+   * @param [in] bits  Width of a cell in bits: 8, 16, 32 or 64
+   */
+  void
+  setCellBits(int bits) BRAINFUCK_NOEXCEPT
+  {
+    cellBits = bits;
+    state = CompileType::kUnknown;
+  }
+
+  /*!
+   * @brief Get the width of a cell
+   * @return Width of a cell in bits, which is taken from the file after
+   *         loadIR()
+   */
+  int
+  getCellBits() const BRAINFUCK_NOEXCEPT
+  {
+    return cellBits;
+  }
+
+  /*!
+   * @brief Enable the on-disk cache of native code
+   *
+   * compile() with CompileType::kJit maps the native code from the cache
+   * if the cache has the code of the same source code and settings, and
+   * otherwise writes the compiled code to the cache.
+   * Only the native code and the output of the prefix are restored from the
+   * cache, so IR code is not available after a cache hit; do not use the
+   * cache with emit() and the dump functions.
+   * @param [in] directory  Cache directory, which is created if it does not
+   *                        exist (empty to disable the cache)
+   * @param [in] version    Version of the program, so that code compiled by
+   *                        another version is not used
+   */
+  void
+  setJitCache(const std::string& directory, const std::string& version)
+  {
+    jitCacheDirectory = directory;
+    jitCacheVersion = version;
+  }
+
+  /*!
+   * @brief Remove extra character from the source code
+   */
+  void
+  trim() BRAINFUCK_NOEXCEPT
+  {
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+    static const std::string kBrainfuckCharacters = "+-><.,[]";
+    bfSource.erase(
+      std::remove_if(
+        std::begin(bfSource),
+        std::end(bfSource),
+        [&](const decltype(kBrainfuckCharacters)::value_type& ch) {
+          return kBrainfuckCharacters.find_first_of(ch) == std::string::npos;
+        }),
+      std::end(bfSource));
+#else
+    bfSource.erase(
+      std::remove_if(
+        bfSource.begin(),
+        bfSource.end(),
+        IsBrainfuckCharacter()),
+      bfSource.end());
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+  }
+
+  /*!
+   * @brief Compile brainfuck source code
+   * @param [in] ct  Compilation type
+   */
+  void
+  compile(CompileType ct=CompileType::kIR, bool hasTopBreakPoint=false)
+  {
+    nativeLoops.reset();
+    switch (ct) {
+      case CompileType::kIR:
+        if (!isIRLoaded) {
+          compileToIR(hasTopBreakPoint);
+          evaluatePrefix();
+          propagateConstants();
+          deferPointerMovement();
+          fuseIR();
+        }
+        if (dispatchType == DispatchType::kPacked) {
+          compileToPackedIR();
+        }
+        break;
+      case CompileType::kJit:
+#ifdef XBYAK32
+        if (cellBits == 64) {
+          throw std::runtime_error("64-bit cells are not supported by JIT compiler on x86");
+        }
+#endif  // XBYAK32
+        cachedCode.reset();
+        if (!jitCacheDirectory.empty()) {
+          cachedCode.reset(new JitCache());
+          if (cachedCode->load(jitCacheDirectory, getJitCacheKey(hasTopBreakPoint), prefixOutput)) {
+            if (!isIRLoaded) {
+              ircode.clear();
+              sourceRanges.clear();
+            }
+            cg.reset();
+            break;
+          }
+          cachedCode.reset();
+        }
+        if (!isIRLoaded) {
+          compileToIR(hasTopBreakPoint);
+          evaluatePrefix();
+          propagateConstants();
+          deferPointerMovement();
+          fuseIR();
+        }
+        compileToNative();
+        if (!jitCacheDirectory.empty()) {
+          JitCache::store(jitCacheDirectory, getJitCacheKey(hasTopBreakPoint), prefixOutput, cg->getCode(), cg->getSize());
+        }
+        break;
+      case CompileType::kTiered:
+#ifdef XBYAK32
+        if (cellBits == 64) {
+          throw std::runtime_error("64-bit cells are not supported by JIT compiler on x86");
+        }
+#endif  // XBYAK32
+        if (!isIRLoaded) {
+          compileToIR(hasTopBreakPoint);
+          evaluatePrefix();
+          propagateConstants();
+          deferPointerMovement();
+          fuseIR();
+        }
+        // Loops are compiled to native code when they become hot in execution
+        cg.reset();
+        nativeLoops.reset(new NativeLoopTable(ircode.size()));
+        break;
+      default:
+        assert(false);
+    }
+    state = ct;
+  }
+
+  /*!
+   * @brief Compile brainfuck source code to IR code
+   */
+  void
+  compileToIR(bool hasTopBreakPoint=false)
+  {
+    std::stack<int> loopStack;
+    std::stack<std::string::size_type> loopSourceStack;
+    ircode.clear();
+    sourceRanges.clear();
+    if (hasTopBreakPoint) {
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+      ircode.emplace_back(BfInst::Type::kBreakPoint);
+#else
+      ircode.push_back(BfInst(BfInst::Type::kBreakPoint));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+      sourceRanges.push_back(SourceRange());
+    }
+    for (std::string::size_type pc = 0; pc < bfSource.size(); pc++) {
+      // Instructions from rewritten to the end of IR code come from begin to
+      // pc of the source code
+      std::vector<BfInst>::size_type rewritten = ircode.size();
+      std::string::size_type begin = pc;
+      const char* origin = NULL;
+      switch (bfSource[pc]) {
+        case '>':
+        case '<':
+          {
+            int offset = (bfSource[pc] == '>' ? 1 : -1);
+            pc++;
+            offset += compressInstruction(pc, '>', '<');
+            if (BRAINFUCK_LIKELY(offset != 0)) {
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+              ircode.emplace_back(BfInst::Type::kMovePointer, offset);
+#else
+              ircode.push_back(BfInst(BfInst::Type::kMovePointer, offset));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+            }
+          }
+          break;
+        case '+':
+        case '-':
+          {
+            int offset = (bfSource[pc] == '+' ? 1 : -1);
+            pc++;
+            offset += compressInstruction(pc, '+', '-');
+            if (BRAINFUCK_LIKELY(offset != 0)) {
+              if (ircode.size() > 0 && ircode[ircode.size() - 1].type == BfInst::Type::kAssign && ircode[ircode.size() - 1].op1 == 0) {
+                ircode[ircode.size() - 1].op1 = offset;
+                rewritten = ircode.size() - 1;
+                begin = sourceRanges[rewritten].begin;
+                origin = sourceRanges[rewritten].origin;
+              } else {
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+                ircode.emplace_back(BfInst::Type::kAdd, offset);
+#else
+                ircode.push_back(BfInst(BfInst::Type::kAdd, offset));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+              }
+            }
+          }
+          break;
+        case '.':
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+          ircode.emplace_back(BfInst::Type::kPutchar);
+#else
+          ircode.push_back(BfInst(BfInst::Type::kPutchar));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+          break;
+        case ',':
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+          ircode.emplace_back(BfInst::Type::kGetchar);
+#else
+          ircode.push_back(BfInst(BfInst::Type::kGetchar));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+          break;
+        case '[':
+          loopStack.push(static_cast<int>(ircode.size()));
+          loopSourceStack.push(pc);
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+          ircode.emplace_back(BfInst::Type::kLoopStart);
+#else
+          ircode.push_back(BfInst(BfInst::Type::kLoopStart));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+          break;
+        case ']':
+          {
+            std::vector<BfInst>::size_type size = ircode.size();
+            if (size == 0) {
+              throw std::runtime_error("Unmatched ']' is detected");
+            }
+            bool isReduced = false;
+            if (size > 0 && ircode[size - 1].type == BfInst::Type::kLoopStart) {
+              isReduced = true;
+              origin = "infinite loop";
+              ircode.resize(ircode.size() - 1);
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+              ircode.emplace_back(BfInst::Type::kInfLoop);
+#else
+              ircode.push_back(BfInst(BfInst::Type::kInfLoop));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+            } else if (size > 1 && ircode[size - 2].type == BfInst::Type::kLoopStart) {
+              const BfInst& prevInst1 = ircode[size - 1];
+              if (prevInst1.type == BfInst::Type::kAdd && std::abs(prevInst1.op1) == 1) {
+                isReduced = true;
+                origin = "clear loop";
+                ircode.resize(ircode.size() - 2);
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+                ircode.emplace_back(BfInst::Type::kAssign, 0);
+#else
+                ircode.push_back(BfInst(BfInst::Type::kAssign, 0));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+              } else if (prevInst1.type == BfInst::Type::kMovePointer) {
+                isReduced = true;
+                origin = "scan loop";
+                ircode.resize(ircode.size() - 2);
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+                ircode.emplace_back(BfInst::Type::kSearchZero, prevInst1.op1);
+#else
+                ircode.push_back(BfInst(BfInst::Type::kSearchZero, prevInst1.op1));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+              }
+            }
+            if (!isReduced) {
+              if (loopStack.empty()) {
+                throw std::runtime_error("Unmatched '[' is detected");
+              }
+              if (reduceLinearLoop(static_cast<std::size_t>(loopStack.top()))) {
+                isReduced = true;
+                origin = "linear loop";
+              } else if (reduceNestedLinearLoop(static_cast<std::size_t>(loopStack.top()))) {
+                isReduced = true;
+                origin = "nested linear loop";
+              }
+            }
+            if (isReduced) {
+              // The whole loop is replaced
+              rewritten = static_cast<std::size_t>(loopStack.top());
+              begin = loopSourceStack.top();
+            }
+            if (!isReduced) {
+              ircode[static_cast<std::size_t>(loopStack.top())].op1 = static_cast<int>(ircode.size());
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+              ircode.emplace_back(BfInst::Type::kLoopEnd, loopStack.top());
+#else
+              ircode.push_back(BfInst(BfInst::Type::kLoopEnd, loopStack.top()));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+            }
+            loopStack.pop();
+            loopSourceStack.pop();
+          }
+          break;
+      }
+      sourceRanges.resize(rewritten);
+      sourceRanges.resize(ircode.size(), SourceRange(begin, std::min(pc + 1, bfSource.size()), origin));
+    }
+    if (!loopStack.empty()) {
+      throw std::runtime_error("Unmatched ']' is detected");
+    }
+  }
+
+  /*!
+   * @brief Reduce a loop which consists only of kMovePointer and kAdd to
+   *        multiply-add instructions
+   *
+   * The loop body is simulated to get the amount of addition to each cell in
+   * one iteration.
+   * If the pointer goes back to the loop counter and the step of the counter
+   * is odd, the loop runs -counter * step^-1 (mod 2^cellBits) times, so every
+   * other cell gets counter multiplied by a constant.
+   * @param [in] base  Index of kLoopStart of the loop
+   * @return True if the loop is reduced, otherwise false
+   */
+  bool
+  reduceLinearLoop(std::vector<BfInst>::size_type base) BRAINFUCK_NOEXCEPT
+  {
+    std::map<int, int> deltaMap;
+    int offset = 0;
+    for (std::vector<BfInst>::size_type pc = base + 1, size = ircode.size(); pc < size; pc++) {
+      switch (ircode[pc].type) {
+        case BfInst::Type::kMovePointer:
+          offset += ircode[pc].op1;
+          break;
+        case BfInst::Type::kAdd:
+          deltaMap[offset] += ircode[pc].op1;
+          break;
+        default:
+          return false;
+      }
+    }
+    std::uint64_t step = static_cast<std::uint64_t>(deltaMap[0]) & getCellMask();
+    if (offset != 0 || (step & 1) == 0) {
+      return false;
+    }
+    std::uint64_t inverse = getCellInverse(step);
+    std::vector<BfInst> reducedCode;
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+    for (const auto& kv : deltaMap) {
+#else
+    for (std::map<int, int>::const_iterator itr = deltaMap.begin(); itr != deltaMap.end(); ++itr) {
+      const std::pair<const int, int>& kv = *itr;
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+      if (kv.first != 0 && !appendMulAdd(reducedCode, kv.first, (0 - inverse) * static_cast<std::uint64_t>(kv.second))) {
+        return false;
+      }
+    }
+    ircode.resize(base);
+    if (reducedCode.empty()) {
+      // No other cell is changed: [-], [---] and so on
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+      ircode.emplace_back(BfInst::Type::kAssign, 0);
+#else
+      ircode.push_back(BfInst(BfInst::Type::kAssign, 0));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+      return true;
+    }
+    appendReducedLoop(base, reducedCode);
+    return true;
+  }
+
+  /*!
+   * @brief Reduce a loop around reduced inner loops to closed form
+   *
+   * One iteration of the loop is simulated as affine expressions of the cell
+   * values at the start of the iteration.
+   * The loop is reduced if the counter is changed by an odd constant and
+   * every other changed cell is either
+   * - a reset cell, which is set to a constant, or
+   * - an accumulator, which gets a constant and values of reset cells.
+   * After n iterations, a reset cell holds its constant and an accumulator
+   * gets the values of reset cells at the first iteration plus n times the
+   * increment of the later iterations, which is linear in the counter.
+   * @param [in] base  Index of kLoopStart of the loop
+   * @return True if the loop is reduced, otherwise false
+   */
+  bool
+  reduceNestedLinearLoop(std::vector<BfInst>::size_type base)
+  {
+    std::map<int, AffineExpr> exprMap;
+    int offset = 0;
+    for (std::vector<BfInst>::size_type pc = base + 1, size = ircode.size(); pc < size; pc++) {
+      const BfInst& inst = ircode[pc];
+      switch (inst.type) {
+        case BfInst::Type::kMovePointer:
+          offset += inst.op1;
+          break;
+        case BfInst::Type::kAdd:
+          {
+            AffineExpr expr = getAffineExpr(exprMap, offset + inst.op2);
+            expr.constant = (expr.constant + static_cast<std::uint64_t>(inst.op1)) & getCellMask();
+            exprMap[offset + inst.op2] = expr;
+          }
+          break;
+        case BfInst::Type::kAssign:
+          exprMap[offset + inst.op2] = AffineExpr();
+          exprMap[offset + inst.op2].constant = static_cast<std::uint64_t>(inst.op1) & getCellMask();
+          break;
+        case BfInst::Type::kIf:
+          // Reduced multiplication loop: no-op if the current cell is zero
+          for (pc++; ircode[pc].type != BfInst::Type::kEndIf; pc++) {
+            const BfInst& bodyInst = ircode[pc];
+            int coefficient = 0;
+            switch (bodyInst.type) {
+              case BfInst::Type::kAddVar:
+                coefficient = 1;
+                break;
+              case BfInst::Type::kSubVar:
+                coefficient = -1;
+                break;
+              case BfInst::Type::kAddCMulVar:
+                coefficient = bodyInst.op2;
+                break;
+              case BfInst::Type::kAssign:
+                if (bodyInst.op1 != 0 || bodyInst.op2 != 0) {
+                  return false;
+                }
+                exprMap[offset] = AffineExpr();
+                continue;
+              default:
+                return false;
+            }
+            AffineExpr expr = getAffineExpr(exprMap, offset + bodyInst.op1);
+            addAffineExpr(expr, getAffineExpr(exprMap, offset), static_cast<std::uint64_t>(coefficient));
+            exprMap[offset + bodyInst.op1] = expr;
+          }
+          break;
+        default:
+          return false;
+      }
+    }
+    if (offset != 0) {
+      return false;
+    }
+    const AffineExpr counter = getAffineExpr(exprMap, 0);
+    if (counter.coefficients.size() != 1 || counter.coefficients.begin()->first != 0
+        || counter.coefficients.begin()->second != 1 || (counter.constant & 1) == 0) {
+      return false;
+    }
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+    for (const auto& kv : exprMap) {
+#else
+    for (std::map<int, AffineExpr>::const_iterator itr = exprMap.begin(); itr != exprMap.end(); ++itr) {
+      const std::pair<const int, AffineExpr>& kv = *itr;
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+      if (kv.first == 0 || kv.second.coefficients.empty()) {
+        continue;
+      }
+      std::map<int, std::uint64_t>::const_iterator selfItr = kv.second.coefficients.find(kv.first);
+      if (selfItr == kv.second.coefficients.end() || selfItr->second != 1) {
+        return false;
+      }
+      for (std::map<int, std::uint64_t>::const_iterator depItr = kv.second.coefficients.begin(); depItr != kv.second.coefficients.end(); ++depItr) {
+        if (depItr->first == kv.first) {
+          continue;
+        }
+        std::map<int, AffineExpr>::const_iterator resetItr = exprMap.find(depItr->first);
+        if (depItr->first == 0 || resetItr == exprMap.end() || !resetItr->second.coefficients.empty()) {
+          return false;
+        }
+      }
+    }
+
+    // The reduced code is built aside, since it is given up if a constant
+    // does not fit in an operand
+    std::uint64_t multiplier = 0 - getCellInverse(counter.constant);
+    std::vector<BfInst> reducedCode;
+    // Accumulators
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+    for (const auto& kv : exprMap) {
+#else
+    for (std::map<int, AffineExpr>::const_iterator itr = exprMap.begin(); itr != exprMap.end(); ++itr) {
+      const std::pair<const int, AffineExpr>& kv = *itr;
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+      if (kv.first == 0 || kv.second.coefficients.empty()) {
+        continue;
+      }
+      std::uint64_t laterIncrement = kv.second.constant;
+      for (std::map<int, std::uint64_t>::const_iterator depItr = kv.second.coefficients.begin(); depItr != kv.second.coefficients.end(); ++depItr) {
+        if (depItr->first == kv.first) {
+          continue;
+        }
+        if (depItr->second == 1 || depItr->second == getCellMask()) {
+          BfInst::Type type = depItr->second == 1 ? BfInst::Type::kAddVarFrom : BfInst::Type::kSubVarFrom;
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+          reducedCode.emplace_back(type, kv.first, depItr->first);
+#else
+          reducedCode.push_back(BfInst(type, kv.first, depItr->first));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+        } else {
+          // Multiply the reset cell in place of the counter
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+          reducedCode.emplace_back(BfInst::Type::kMovePointer, depItr->first);
+#else
+          reducedCode.push_back(BfInst(BfInst::Type::kMovePointer, depItr->first));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+          if (!appendMulAdd(reducedCode, kv.first - depItr->first, depItr->second)) {
+            return false;
+          }
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+          reducedCode.emplace_back(BfInst::Type::kMovePointer, -depItr->first);
+#else
+          reducedCode.push_back(BfInst(BfInst::Type::kMovePointer, -depItr->first));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+        }
+        laterIncrement += depItr->second * exprMap[depItr->first].constant;
+      }
+      std::uint64_t correction = (kv.second.constant - laterIncrement) & getCellMask();
+      if (correction != 0) {
+        if (!isCellOperand(correction)) {
+          return false;
+        }
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+        reducedCode.emplace_back(BfInst::Type::kAdd, toCellValue(correction), kv.first);
+#else
+        reducedCode.push_back(BfInst(BfInst::Type::kAdd, toCellValue(correction), kv.first));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+      }
+      if (!appendMulAdd(reducedCode, kv.first, multiplier * laterIncrement)) {
+        return false;
+      }
+    }
+    // Reset cells
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+    for (const auto& kv : exprMap) {
+#else
+    for (std::map<int, AffineExpr>::const_iterator itr = exprMap.begin(); itr != exprMap.end(); ++itr) {
+      const std::pair<const int, AffineExpr>& kv = *itr;
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+      if (kv.first != 0 && kv.second.coefficients.empty()) {
+        if (!isCellOperand(kv.second.constant)) {
+          return false;
+        }
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+        reducedCode.emplace_back(BfInst::Type::kAssign, toCellValue(kv.second.constant), kv.first);
+#else
+        reducedCode.push_back(BfInst(BfInst::Type::kAssign, toCellValue(kv.second.constant), kv.first));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+      }
+    }
+    ircode.resize(base);
+    appendReducedLoop(base, reducedCode);
+    return true;
+  }
+
+  /*!
+   * @brief Append a reduced loop: the reduced body guarded with kIf, followed
+   *        by clearing the loop counter
+   * @param [in] base         Index of kIf, which must be the end of IR code
+   * @param [in] reducedCode  Reduced body of the loop
+   */
+  void
+  appendReducedLoop(std::vector<BfInst>::size_type base, const std::vector<BfInst>& reducedCode)
+  {
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+    ircode.emplace_back(BfInst::Type::kIf);
+    ircode.insert(ircode.end(), reducedCode.begin(), reducedCode.end());
+    ircode.emplace_back(BfInst::Type::kAssign, 0);
+    ircode[base].op1 = static_cast<int>(ircode.size());
+    ircode.emplace_back(BfInst::Type::kEndIf, static_cast<int>(base));
+#else
+    ircode.push_back(BfInst(BfInst::Type::kIf));
+    ircode.insert(ircode.end(), reducedCode.begin(), reducedCode.end());
+    ircode.push_back(BfInst(BfInst::Type::kAssign, 0));
+    ircode[base].op1 = static_cast<int>(ircode.size());
+    ircode.push_back(BfInst(BfInst::Type::kEndIf, static_cast<int>(base)));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+  }
+
+  /*!
+   * @brief Append an instruction which adds the current cell multiplied by a
+   *        constant to another cell
+   * @param [in,out] code         Destination IR code
+   * @param [in]     offset       Offset of the destination cell
+   * @param [in]     coefficient  Coefficient
+   * @return True if the coefficient fits in an operand, otherwise false
+   */
+  bool
+  appendMulAdd(std::vector<BfInst>& code, int offset, std::uint64_t coefficient) const
+  {
+    if (!isCellOperand(coefficient)) {
+      return false;
+    }
+    int value = toCellValue(coefficient);
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+    if (value == 1) {
+      code.emplace_back(BfInst::Type::kAddVar, offset);
+    } else if (value == -1) {
+      code.emplace_back(BfInst::Type::kSubVar, offset);
+    } else if (value != 0) {
+      code.emplace_back(BfInst::Type::kAddCMulVar, offset, value);
+    }
+#else
+    if (value == 1) {
+      code.push_back(BfInst(BfInst::Type::kAddVar, offset));
+    } else if (value == -1) {
+      code.push_back(BfInst(BfInst::Type::kSubVar, offset));
+    } else if (value != 0) {
+      code.push_back(BfInst(BfInst::Type::kAddCMulVar, offset, value));
+    }
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+    return true;
+  }
+
+  /*!
+   * @brief Get an affine expression of a cell
+   * @param [in] exprMap  Affine expressions of changed cells
+   * @param [in] offset   Offset of the cell
+   * @return The expression in exprMap, or the cell value itself if the cell
+   *         is not changed
+   */
+  static AffineExpr
+  getAffineExpr(const std::map<int, AffineExpr>& exprMap, int offset)
+  {
+    std::map<int, AffineExpr>::const_iterator itr = exprMap.find(offset);
+    if (itr != exprMap.end()) {
+      return itr->second;
+    }
+    AffineExpr expr;
+    expr.coefficients[offset] = 1;
+    return expr;
+  }
+
+  /*!
+   * @brief Add an affine expression multiplied by a constant to another one
+   * @param [in,out] dst          Destination expression
+   * @param [in]     src          Source expression
+   * @param [in]     coefficient  Coefficient
+   */
+  void
+  addAffineExpr(AffineExpr& dst, const AffineExpr& src, std::uint64_t coefficient) const
+  {
+    for (std::map<int, std::uint64_t>::const_iterator itr = src.coefficients.begin(); itr != src.coefficients.end(); ++itr) {
+      std::uint64_t value = (dst.coefficients[itr->first] + itr->second * coefficient) & getCellMask();
+      if (value == 0) {
+        dst.coefficients.erase(itr->first);
+      } else {
+        dst.coefficients[itr->first] = value;
+      }
+    }
+    dst.constant = (dst.constant + src.constant * coefficient) & getCellMask();
+  }
+
+  /*!
+   * @brief Get the mask of the bits of a cell
+   * @return 2^cellBits - 1
+   */
+  std::uint64_t
+  getCellMask() const BRAINFUCK_NOEXCEPT
+  {
+    return ~0ULL >> (64 - cellBits);
+  }
+
+  /*!
+   * @brief Get the multiplicative inverse of an odd cell value
+   *
+   * An odd value is its own inverse modulo 8, and each Newton step doubles
+   * the number of correct low bits.
+   * @param [in] value  Odd cell value
+   * @return Inverse of value modulo 2^cellBits
+   */
+  std::uint64_t
+  getCellInverse(std::uint64_t value) const BRAINFUCK_NOEXCEPT
+  {
+    std::uint64_t inverse = value;
+    for (int i = 0; i < 5; i++) {
+      inverse *= 2 - value * inverse;
+    }
+    return inverse & getCellMask();
+  }
+
+  /*!
+   * @brief Wrap a value into the range of signed cell values
+   * @param [in] value  Value
+   * @return The value modulo 2^cellBits in [-2^(cellBits-1), 2^(cellBits-1))
+   */
+  std::int64_t
+  toSignedCellValue(std::uint64_t value) const BRAINFUCK_NOEXCEPT
+  {
+    value &= getCellMask();
+    return static_cast<std::int64_t>((value >> (cellBits - 1)) != 0 ? value | ~getCellMask() : value);
+  }
+
+  /*!
+   * @brief Check whether a cell value fits in an operand of IR code
+   * @param [in] value  Value
+   * @return True if the signed cell value fits in int, which always holds for
+   *         cells up to 32 bits
+   */
+  bool
+  isCellOperand(std::uint64_t value) const BRAINFUCK_NOEXCEPT
+  {
+    std::int64_t signedValue = toSignedCellValue(value);
+    return std::numeric_limits<int>::min() <= signedValue && signedValue <= std::numeric_limits<int>::max();
+  }
+
+  /*!
+   * @brief Wrap a value into an operand of IR code
+   * @param [in] value  Value, for which isCellOperand() must be true
+   * @return The signed cell value
+   */
+  int
+  toCellValue(std::uint64_t value) const BRAINFUCK_NOEXCEPT
+  {
+    return static_cast<int>(toSignedCellValue(value));
+  }
+
+  /*!
+   * @brief Propagate known cell values through IR code
+   *
+   * The tape starts with all zero and the current cell is zero after every
+   * loop.
+   * Writes of known values are kept as pending values and written to the
+   * tape with kAssign only before an instruction which needs them, so
+   * constant-building code is folded into a few kAssign.
+   * Loops, kIf blocks and kSearchZero on a known zero cell are removed, and
+   * kIf blocks on a known non-zero cell are executed at compile time.
+   * Cell values are held in std::int64_t with -1 for unknown values, so this
+   * is skipped for 64-bit cells.
+   */
+  void
+  propagateConstants()
+  {
+    if (cellBits == 64) {
+      return;
+    }
+    std::vector<BfInst> foldedCode;
+    std::vector<SourceRange> foldedRanges;
+    std::vector<int> indexMap(ircode.size(), -1);
+    std::stack<bool> isElidedStack;
+    std::stack<TapeState> ifStateStack;
+    TapeState state;
+    foldedCode.reserve(ircode.size());
+    for (std::vector<BfInst>::size_type pc = 0, size = ircode.size(); pc < size; pc++) {
+      const BfInst& inst = ircode[pc];
+      std::int64_t cur = getCellValue(state, state.pointer);
+      switch (inst.type) {
+        case BfInst::Type::kMovePointer:
+          state.pointer += inst.op1;
+          foldedCode.push_back(inst);
+          break;
+        case BfInst::Type::kAdd:
+          {
+            std::int64_t value = getCellValue(state, state.pointer + inst.op2);
+            if (value == -1) {
+              foldedCode.push_back(inst);
+            } else {
+              setCellValue(state, state.pointer + inst.op2, static_cast<std::uint64_t>(value + inst.op1), sourceRanges[pc]);
+            }
+          }
+          break;
+        case BfInst::Type::kAssign:
+          setCellValue(state, state.pointer + inst.op2, static_cast<std::uint64_t>(inst.op1), sourceRanges[pc]);
+          break;
+        case BfInst::Type::kPutchar:
+          flushCell(state, state.pointer + inst.op1, foldedCode, foldedRanges);
+          foldedCode.push_back(inst);
+          break;
+        case BfInst::Type::kGetchar:
+          state.dirtyMap.erase(state.pointer + inst.op1);
+          state.rangeMap.erase(state.pointer + inst.op1);
+          state.valueMap[state.pointer + inst.op1] = -1;
+          foldedCode.push_back(inst);
+          break;
+        case BfInst::Type::kLoopStart:
+          if (cur == 0) {
+            // Never entered
+            pc = static_cast<std::size_t>(inst.op1);
+            break;
+          }
+          flushCells(state, foldedCode, foldedRanges);
+          indexMap[pc] = static_cast<int>(foldedCode.size());
+          foldedCode.push_back(inst);
+          forgetCells(state);
+          break;
+        case BfInst::Type::kLoopEnd:
+          flushCells(state, foldedCode, foldedRanges);
+          indexMap[pc] = static_cast<int>(foldedCode.size());
+          foldedCode.push_back(inst);
+          forgetCells(state);
+          state.valueMap[state.pointer] = 0;
+          break;
+        case BfInst::Type::kIf:
+          if (cur == 0) {
+            pc = static_cast<std::size_t>(inst.op1);
+            break;
+          }
+          isElidedStack.push(cur != -1);
+          if (cur == -1) {
+            flushCells(state, foldedCode, foldedRanges);
+            ifStateStack.push(state);
+            // The guard is zero if the block is skipped
+            ifStateStack.top().valueMap[state.pointer] = 0;
+            indexMap[pc] = static_cast<int>(foldedCode.size());
+            foldedCode.push_back(inst);
+          }
+          break;
+        case BfInst::Type::kEndIf:
+          if (!isElidedStack.top()) {
+            flushCells(state, foldedCode, foldedRanges);
+            indexMap[pc] = static_cast<int>(foldedCode.size());
+            foldedCode.push_back(inst);
+            state = joinTapeStates(ifStateStack.top(), state);
+            ifStateStack.pop();
+          }
+          isElidedStack.pop();
+          break;
+        case BfInst::Type::kSearchZero:
+          if (cur != 0) {
+            flushCells(state, foldedCode, foldedRanges);
+            foldedCode.push_back(inst);
+            forgetCells(state);
+            state.valueMap[state.pointer] = 0;
+          }
+          break;
+        case BfInst::Type::kAddVar:
+          foldMulAdd(state, state.pointer, state.pointer + inst.op1, 1, inst, sourceRanges[pc], foldedCode, foldedRanges);
+          break;
+        case BfInst::Type::kSubVar:
+          foldMulAdd(state, state.pointer, state.pointer + inst.op1, -1, inst, sourceRanges[pc], foldedCode, foldedRanges);
+          break;
+        case BfInst::Type::kAddCMulVar:
+          foldMulAdd(state, state.pointer, state.pointer + inst.op1, inst.op2, inst, sourceRanges[pc], foldedCode, foldedRanges);
+          break;
+        case BfInst::Type::kAddVarFrom:
+          foldMulAdd(state, state.pointer + inst.op2, state.pointer + inst.op1, 1, inst, sourceRanges[pc], foldedCode, foldedRanges);
+          break;
+        case BfInst::Type::kSubVarFrom:
+          foldMulAdd(state, state.pointer + inst.op2, state.pointer + inst.op1, -1, inst, sourceRanges[pc], foldedCode, foldedRanges);
+          break;
+        case BfInst::Type::kInfLoop:
+          if (cur != 0) {
+            flushCells(state, foldedCode, foldedRanges);
+            foldedCode.push_back(inst);
+            state.valueMap[state.pointer] = 0;
+          }
+          break;
+        default:
+          flushCells(state, foldedCode, foldedRanges);
+          foldedCode.push_back(inst);
+          break;
+      }
+      appendSourceRanges(foldedRanges, foldedCode, pc, "constant propagation");
+    }
+    relocateJumps(foldedCode, indexMap);
+    ircode.swap(foldedCode);
+    sourceRanges.swap(foldedRanges);
+  }
+
+  /*!
+   * @brief Fold an instruction which adds a cell multiplied by a constant to
+   *        another cell
+   * @param [in,out] state        Known cell values
+   * @param [in]     src          Offset of the source cell from the base
+   * @param [in]     dst          Offset of the destination cell from the base
+   * @param [in]     coefficient  Coefficient
+   * @param [in]     inst         The instruction
+   * @param [in]     range        Source range of the instruction
+   * @param [in,out] code         Destination IR code
+   * @param [in,out] ranges       Source ranges of the destination IR code
+   */
+  void
+  foldMulAdd(TapeState& state, int src, int dst, int coefficient, const BfInst& inst, const SourceRange& range,
+      std::vector<BfInst>& code, std::vector<SourceRange>& ranges) const
+  {
+    std::int64_t srcValue = getCellValue(state, src);
+    if (srcValue == -1) {
+      flushCell(state, dst, code, ranges);
+      code.push_back(inst);
+      state.valueMap[dst] = -1;
+      return;
+    }
+    std::uint64_t product = static_cast<std::uint64_t>(srcValue) * static_cast<std::uint64_t>(coefficient);
+    std::int64_t dstValue = getCellValue(state, dst);
+    if (dstValue != -1) {
+      setCellValue(state, dst, static_cast<std::uint64_t>(dstValue) + product, range);
+    } else if (toCellValue(product) != 0) {
+      code.push_back(BfInst(BfInst::Type::kAdd, toCellValue(product), dst - state.pointer));
+    }
+  }
+
+  /*!
+   * @brief Get a known cell value
+   * @param [in] state   Known cell values
+   * @param [in] offset  Offset of the cell from the base
+   * @return Cell value, or -1 if unknown
+   */
+  static std::int64_t
+  getCellValue(const TapeState& state, int offset)
+  {
+    std::map<int, std::int64_t>::const_iterator itr = state.valueMap.find(offset);
+    if (itr != state.valueMap.end()) {
+      return itr->second;
+    }
+    return state.isRestZero ? 0 : -1;
+  }
+
+  /*!
+   * @brief Set a known cell value, which is written to the tape later
+   * @param [in,out] state   Known cell values
+   * @param [in]     offset  Offset of the cell from the base
+   * @param [in]     value   Cell value
+   * @param [in]     range   Source range of the instruction which sets the
+   *                         value
+   */
+  void
+  setCellValue(TapeState& state, int offset, std::uint64_t value, const SourceRange& range) const
+  {
+    if (state.dirtyMap.find(offset) == state.dirtyMap.end()) {
+      state.dirtyMap[offset] = getCellValue(state, offset);
+    }
+    state.rangeMap[offset] = range;
+    state.valueMap[offset] = static_cast<std::int64_t>(value & getCellMask());
+  }
+
+  /*!
+   * @brief Write a pending cell value to the tape
+   *
+   * The kAssign gets the source range of the instruction which set the value
+   * last, so that it is attributed to the code which computed it rather than
+   * to the instruction which needs it.
+   * @param [in,out] state   Known cell values
+   * @param [in]     offset  Offset of the cell from the base
+   * @param [in,out] code    Destination IR code
+   * @param [in,out] ranges  Source ranges of the destination IR code
+   */
+  void
+  flushCell(TapeState& state, int offset, std::vector<BfInst>& code, std::vector<SourceRange>& ranges) const
+  {
+    std::map<int, std::int64_t>::iterator itr = state.dirtyMap.find(offset);
+    if (itr == state.dirtyMap.end()) {
+      return;
+    }
+    if (state.valueMap[offset] != itr->second) {
+      code.push_back(BfInst(BfInst::Type::kAssign, toCellValue(static_cast<std::uint64_t>(state.valueMap[offset])), offset - state.pointer));
+      appendFlushedRange(ranges, state.rangeMap[offset]);
+    }
+    state.dirtyMap.erase(itr);
+    state.rangeMap.erase(offset);
+  }
+
+  /*!
+   * @brief Write all pending cell values to the tape
+   * @param [in,out] state   Known cell values
+   * @param [in,out] code    Destination IR code
+   * @param [in,out] ranges  Source ranges of the destination IR code
+   */
+  void
+  flushCells(TapeState& state, std::vector<BfInst>& code, std::vector<SourceRange>& ranges) const
+  {
+    for (std::map<int, std::int64_t>::const_iterator itr = state.dirtyMap.begin(); itr != state.dirtyMap.end(); ++itr) {
+      if (state.valueMap[itr->first] != itr->second) {
+        code.push_back(BfInst(BfInst::Type::kAssign, toCellValue(static_cast<std::uint64_t>(state.valueMap[itr->first])), itr->first - state.pointer));
+        appendFlushedRange(ranges, state.rangeMap[itr->first]);
+      }
+    }
+    state.dirtyMap.clear();
+    state.rangeMap.clear();
+  }
+
+  /*!
+   * @brief Append the source range of a kAssign which writes a pending cell
+   *        value
+   *
+   * Pending values are written before any other instruction is emitted for
+   * the current instruction, so ranges covers all of the code but the kAssign.
+   * @param [in,out] ranges  Source ranges of the destination IR code
+   * @param [in]     range   Source range of the instruction which set the
+   *                         value last
+   */
+  static void
+  appendFlushedRange(std::vector<SourceRange>& ranges, const SourceRange& range)
+  {
+    ranges.push_back(range);
+    if (ranges.back().origin == NULL) {
+      ranges.back().origin = "constant propagation";
+    }
+  }
+
+  /*!
+   * @brief Forget all known cell values
+   * @param [in,out] state  Known cell values, which must have no pending value
+   */
+  static void
+  forgetCells(TapeState& state)
+  {
+    state.valueMap.clear();
+    state.isRestZero = false;
+  }
+
+  /*!
+   * @brief Merge known cell values of two paths
+   * @param [in] state1  Known cell values of one path
+   * @param [in] state2  Known cell values of the other path
+   * @return Cell values known in both paths
+   */
+  static TapeState
+  joinTapeStates(const TapeState& state1, const TapeState& state2)
+  {
+    TapeState joined;
+    joined.pointer = state2.pointer;
+    if (state1.pointer != state2.pointer) {
+      forgetCells(joined);
+      return joined;
+    }
+    joined.isRestZero = state1.isRestZero && state2.isRestZero;
+    std::set<int> offsets;
+    for (std::map<int, std::int64_t>::const_iterator itr = state1.valueMap.begin(); itr != state1.valueMap.end(); ++itr) {
+      offsets.insert(itr->first);
+    }
+    for (std::map<int, std::int64_t>::const_iterator itr = state2.valueMap.begin(); itr != state2.valueMap.end(); ++itr) {
+      offsets.insert(itr->first);
+    }
+    for (std::set<int>::const_iterator itr = offsets.begin(); itr != offsets.end(); ++itr) {
+      std::int64_t value = getCellValue(state1, *itr);
+      joined.valueMap[*itr] = value == getCellValue(state2, *itr) ? value : -1;
+    }
+    return joined;
+  }
+
+  /*!
+   * @brief Execute the input-independent prefix of IR code at compile time
+   *
+   * IR code is executed from the top until the first kGetchar or kBreakPoint,
+   * a hanging kInfLoop, or until the step or memory budget runs out.
+   * Execution is rolled back to the last instruction outside of any loop, and
+   * the executed part is replaced with kAssign of the non-zero cells and
+   * kMovePointer to the pointer position.
+   * The output of the executed part is kept in prefixOutput, which every
+   * engine and code generator writes before running the rest of the code.
+   */
+  void
+  evaluatePrefix()
+  {
+    switch (cellBits) {
+      case 16:
+        evaluatePrefixCells<std::uint16_t>();
+        break;
+      case 32:
+        evaluatePrefixCells<std::uint32_t>();
+        break;
+      case 64:
+        evaluatePrefixCells<std::uint64_t>();
+        break;
+      default:
+        evaluatePrefixCells<unsigned char>();
+        break;
+    }
+  }
+
+  /*!
+   * @brief Execute the input-independent prefix of IR code at compile time on
+   *        a tape of the given cell type
+   *
+   * The executed part is kept if a cell value does not fit in an operand of
+   * kAssign.
+   * @tparam CellT  Cell type
+   */
+  template<typename CellT>
+  void
+  evaluatePrefixCells()
+  {
+    prefixOutput.clear();
+    if (evalStepLimit == 0 || evalMemoryLimit == 0) {
+      return;
+    }
+    std::vector<BfInst>::size_type size = ircode.size();
+    std::vector<bool> isTopLevel(size, false);
+    int depth = 0;
+    for (std::vector<BfInst>::size_type pc = 0; pc < size; pc++) {
+      switch (ircode[pc].type) {
+        case BfInst::Type::kLoopStart:
+        case BfInst::Type::kIf:
+          isTopLevel[pc] = depth == 0;
+          depth++;
+          break;
+        case BfInst::Type::kLoopEnd:
+        case BfInst::Type::kEndIf:
+          depth--;
+          break;
+        default:
+          isTopLevel[pc] = depth == 0;
+          break;
+      }
+    }
+
+    std::vector<CellT> tape;
+    std::vector<CellT> savedTape;
+    std::string output;
+    std::vector<BfInst>::size_type checkpoint = 0;
+    std::string::size_type checkpointOutputSize = 0;
+    int checkpointPointer = 0;
+    bool hasSavedTape = false;
+    bool isStopped = false;
+    int pointer = 0;
+    std::size_t nSteps = 0;
+    for (std::vector<BfInst>::size_type pc = 0; pc < size && !isStopped; pc++) {
+      const BfInst& inst = ircode[pc];
+      if (isTopLevel[pc]) {
+        checkpoint = pc;
+        checkpointPointer = pointer;
+        checkpointOutputSize = output.size();
+        hasSavedTape = false;
+      }
+      if (nSteps == evalStepLimit) {
+        isStopped = true;
+        break;
+      }
+      nSteps++;
+      switch (inst.type) {
+        case BfInst::Type::kMovePointer:
+          pointer += inst.op1;
+          break;
+        case BfInst::Type::kAdd:
+          if (!(isStopped = !reserveEvalCell(tape, pointer + inst.op2))) {
+            std::size_t address = static_cast<std::size_t>(pointer + inst.op2);
+            tape[address] = static_cast<CellT>(tape[address] + static_cast<CellT>(inst.op1));
+          }
+          break;
+        case BfInst::Type::kAssign:
+          if (!(isStopped = !reserveEvalCell(tape, pointer + inst.op2))) {
+            tape[static_cast<std::size_t>(pointer + inst.op2)] = static_cast<CellT>(inst.op1);
+          }
+          break;
+        case BfInst::Type::kPutchar:
+          if (!(isStopped = !reserveEvalCell(tape, pointer + inst.op1))) {
+            output += static_cast<char>(tape[static_cast<std::size_t>(pointer + inst.op1)]);
+          }
+          break;
+        case BfInst::Type::kLoopStart:
+        case BfInst::Type::kIf:
+          if (!(isStopped = !reserveEvalCell(tape, pointer))) {
+            if (tape[static_cast<std::size_t>(pointer)] == 0) {
+              pc = static_cast<std::size_t>(inst.op1);
+            } else if (isTopLevel[pc]) {
+              savedTape = tape;
+              hasSavedTape = true;
+            }
+          }
+          break;
+        case BfInst::Type::kLoopEnd:
+          if (!(isStopped = !reserveEvalCell(tape, pointer)) && tape[static_cast<std::size_t>(pointer)] != 0) {
+            pc = static_cast<std::size_t>(inst.op1);
+          }
+          break;
+        case BfInst::Type::kEndIf:
+          break;
+        case BfInst::Type::kSearchZero:
+          while (!(isStopped = !reserveEvalCell(tape, pointer)) && tape[static_cast<std::size_t>(pointer)] != 0) {
+            if (nSteps == evalStepLimit) {
+              isStopped = true;
+              break;
+            }
+            nSteps++;
+            pointer += inst.op1;
+          }
+          break;
+        case BfInst::Type::kAddVar:
+        case BfInst::Type::kSubVar:
+        case BfInst::Type::kAddCMulVar:
+          if (!(isStopped = !reserveEvalCell(tape, pointer) || !reserveEvalCell(tape, pointer + inst.op1))) {
+            int coefficient = inst.type == BfInst::Type::kAddVar ? 1
+              : inst.type == BfInst::Type::kSubVar ? -1
+              : inst.op2;
+            std::size_t address = static_cast<std::size_t>(pointer + inst.op1);
+            tape[address] = mulAddCell(tape[address], tape[static_cast<std::size_t>(pointer)], coefficient);
+          }
+          break;
+        case BfInst::Type::kAddVarFrom:
+        case BfInst::Type::kSubVarFrom:
+          if (!(isStopped = !reserveEvalCell(tape, pointer + inst.op1) || !reserveEvalCell(tape, pointer + inst.op2))) {
+            int coefficient = inst.type == BfInst::Type::kAddVarFrom ? 1 : -1;
+            std::size_t address = static_cast<std::size_t>(pointer + inst.op1);
+            tape[address] = mulAddCell(tape[address], tape[static_cast<std::size_t>(pointer + inst.op2)], coefficient);
+          }
+          break;
+        case BfInst::Type::kInfLoop:
+          isStopped = !reserveEvalCell(tape, pointer) || tape[static_cast<std::size_t>(pointer)] != 0;
+          break;
+        default:
+          // kGetchar, kBreakPoint and fused instructions
+          isStopped = true;
+          break;
+      }
+    }
+
+    if (!isStopped) {
+      prefixOutput.swap(output);
+      ircode.clear();
+      sourceRanges.clear();
+      return;
+    }
+    if (checkpoint == 0) {
+      return;
+    }
+    if (hasSavedTape) {
+      tape.swap(savedTape);
+    }
+
+    std::vector<BfInst> residualCode;
+    for (typename std::vector<CellT>::size_type i = 0; i < tape.size(); i++) {
+      if (tape[i] != 0) {
+        if (!isCellOperand(tape[i])) {
+          return;
+        }
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+        residualCode.emplace_back(BfInst::Type::kAssign, toCellValue(tape[i]), static_cast<int>(i));
+#else
+        residualCode.push_back(BfInst(BfInst::Type::kAssign, toCellValue(tape[i]), static_cast<int>(i)));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+      }
+    }
+    if (checkpointPointer != 0) {
+#ifdef BRAINFUCK_EMPLACE_AVAILABLE
+      residualCode.emplace_back(BfInst::Type::kMovePointer, checkpointPointer);
+#else
+      residualCode.push_back(BfInst(BfInst::Type::kMovePointer, checkpointPointer));
+#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+    }
+    output.resize(checkpointOutputSize);
+    prefixOutput.swap(output);
+    std::vector<SourceRange> residualRanges(residualCode.size(), SourceRange(0, sourceRanges[checkpoint].begin, "prefix evaluation"));
+    std::vector<int> indexMap(size, -1);
+    for (std::vector<BfInst>::size_type i = checkpoint; i < size; i++) {
+      indexMap[i] = static_cast<int>(residualCode.size());
+      residualCode.push_back(ircode[i]);
+      residualRanges.push_back(sourceRanges[i]);
+    }
+    relocateJumps(residualCode, indexMap);
+    ircode.swap(residualCode);
+    sourceRanges.swap(residualRanges);
+  }
+
+  /*!
+   * @brief Make a cell of the compile-time tape accessible
+   * @tparam CellT  Cell type
+   * @param [in,out] tape     Compile-time tape
+   * @param [in]     address  Address of the cell
+   * @return True if the cell is within the memory budget, otherwise false
+   */
+  template<typename CellT>
+  bool
+  reserveEvalCell(std::vector<CellT>& tape, int address) const BRAINFUCK_NOEXCEPT
+  {
+    if (address < 0 || static_cast<std::size_t>(address) >= evalMemoryLimit) {
+      return false;
+    }
+    if (static_cast<std::size_t>(address) >= tape.size()) {
+      tape.resize(std::min(std::max(tape.size() * 2, static_cast<std::size_t>(address) + 1), evalMemoryLimit), 0);
+    }
+    return true;
+  }
+
+  /*!
+   * @brief Defer pointer movement across straight-line code
+   *
+   * Pointer movement is accumulated as a virtual offset while kAdd, kAssign,
+   * kPutchar and kGetchar get it as their offset operand, and one kMovePointer
+   * is emitted before the next control-flow instruction.
+   */
+  void
+  deferPointerMovement() BRAINFUCK_NOEXCEPT
+  {
+    std::vector<BfInst> deferredCode;
+    std::vector<SourceRange> deferredRanges;
+    std::vector<int> indexMap(ircode.size());
+    deferredCode.reserve(ircode.size());
+    int offset = 0;
+    for (std::vector<BfInst>::size_type pc = 0, size = ircode.size(); pc < size; pc++) {
+      const BfInst& inst = ircode[pc];
+      indexMap[pc] = static_cast<int>(deferredCode.size());
+      switch (inst.type) {
+        case BfInst::Type::kMovePointer:
+          offset += inst.op1;
+          break;
+        case BfInst::Type::kAdd:
+        case BfInst::Type::kAssign:
+          deferredCode.push_back(BfInst(inst.type, inst.op1, inst.op2 + offset));
+          break;
+        case BfInst::Type::kPutchar:
+        case BfInst::Type::kGetchar:
+          deferredCode.push_back(BfInst(inst.type, inst.op1 + offset));
+          break;
+        default:
+          if (offset != 0) {
+            deferredCode.push_back(BfInst(BfInst::Type::kMovePointer, offset));
+            offset = 0;
+          }
+          indexMap[pc] = static_cast<int>(deferredCode.size());
+          deferredCode.push_back(inst);
+          break;
+      }
+      appendSourceRanges(deferredRanges, deferredCode, pc, "deferred pointer movement");
+    }
+    relocateJumps(deferredCode, indexMap);
+    ircode.swap(deferredCode);
+    sourceRanges.swap(deferredRanges);
+  }
+
+  /*!
+   * @brief Fuse frequent pairs of IR instructions into superinstructions
+   *
+   * The pairs are chosen from the execution frequencies of instruction pairs
+   * on the test programs: pointer movement followed by kAdd, kAssign, kIf or
+   * kLoopEnd, and kAdd or kAssign followed by pointer movement.
+   * kAdd and kAssign with an offset are not fused.
+   */
+  void
+  fuseIR() BRAINFUCK_NOEXCEPT
+  {
+    std::vector<BfInst> fusedCode;
+    std::vector<SourceRange> fusedRanges;
+    std::vector<int> indexMap(ircode.size());
+    fusedCode.reserve(ircode.size());
+    for (std::vector<BfInst>::size_type pc = 0, size = ircode.size(); pc < size; pc++) {
+      const BfInst& inst = ircode[pc];
+      indexMap[pc] = static_cast<int>(fusedCode.size());
+      if (pc + 1 < size) {
+        const BfInst& next = ircode[pc + 1];
+        BfInst fusedInst;
+        if (inst.type == BfInst::Type::kMovePointer) {
+          switch (next.type) {
+            case BfInst::Type::kAdd:
+              if (next.op2 == 0) {
+                fusedInst = BfInst(BfInst::Type::kMovePointerAdd, inst.op1, next.op1);
+              }
+              break;
+            case BfInst::Type::kAssign:
+              if (next.op2 == 0) {
+                fusedInst = BfInst(BfInst::Type::kMovePointerAssign, inst.op1, next.op1);
+              }
+              break;
+            case BfInst::Type::kIf:
+              fusedInst = BfInst(BfInst::Type::kMovePointerIf, next.op1, inst.op1);
+              break;
+            case BfInst::Type::kLoopEnd:
+              fusedInst = BfInst(BfInst::Type::kMovePointerLoopEnd, next.op1, inst.op1);
+              break;
+            default:
+              break;
+          }
+        } else if (next.type == BfInst::Type::kMovePointer && inst.op2 == 0) {
+          switch (inst.type) {
+            case BfInst::Type::kAdd:
+              fusedInst = BfInst(BfInst::Type::kAddMovePointer, inst.op1, next.op1);
+              break;
+            case BfInst::Type::kAssign:
+              fusedInst = BfInst(BfInst::Type::kAssignMovePointer, inst.op1, next.op1);
+              break;
+            default:
+              break;
+          }
+        }
+        if (fusedInst.type != BfInst::Type::kUnknown) {
+          // Prefer the origin of the instruction other than the pointer
+          // movement
+          const SourceRange& range = sourceRanges[pc];
+          const SourceRange& nextRange = sourceRanges[pc + 1];
+          const char* origin = inst.type == BfInst::Type::kMovePointer ? nextRange.origin : range.origin;
+          fusedRanges.push_back(SourceRange(
+                std::min(range.begin, nextRange.begin),
+                std::max(range.end, nextRange.end),
+                origin != NULL ? origin : inst.type == BfInst::Type::kMovePointer ? range.origin : nextRange.origin));
+          indexMap[++pc] = static_cast<int>(fusedCode.size());
+          fusedCode.push_back(fusedInst);
+          continue;
+        }
+      }
+      fusedCode.push_back(inst);
+      fusedRanges.push_back(sourceRanges[pc]);
+    }
+    relocateJumps(fusedCode, indexMap);
+    ircode.swap(fusedCode);
+    sourceRanges.swap(fusedRanges);
+  }
+
+  /*!
+   * @brief Relocate jump destinations of rewritten IR code
+   * @param [in,out] code      Rewritten IR code
+   * @param [in]     indexMap  Map from old instruction indices to new ones
+   */
+  static void
+  relocateJumps(std::vector<BfInst>& code, const std::vector<int>& indexMap) BRAINFUCK_NOEXCEPT
+  {
+    for (std::vector<BfInst>::size_type pc = 0, size = code.size(); pc < size; pc++) {
+      if (isJumpInstruction(code[pc].type) || code[pc].type == BfInst::Type::kEndIf) {
+        code[pc].op1 = indexMap[static_cast<std::size_t>(code[pc].op1)];
+      }
+    }
   }
 
   /*!
-   * @brief Compile brainfuck source code
-   * @param [in] ct  Compilation type
+   * @brief Get the name of a type of IR instructions
+   * @param [in] type  Type of an IR instruction
+   * @return Name of the type
+   */
+  static const char*
+  getInstructionName(BfInst::Type type) BRAINFUCK_NOEXCEPT
+  {
+    switch (type) {
+      case BfInst::Type::kMovePointer:
+        return "kMovePointer";
+      case BfInst::Type::kAdd:
+        return "kAdd";
+      case BfInst::Type::kPutchar:
+        return "kPutchar";
+      case BfInst::Type::kGetchar:
+        return "kGetchar";
+      case BfInst::Type::kLoopStart:
+        return "kLoopStart";
+      case BfInst::Type::kLoopEnd:
+        return "kLoopEnd";
+      case BfInst::Type::kIf:
+        return "kIf";
+      case BfInst::Type::kEndIf:
+        return "kEndIf";
+      case BfInst::Type::kAssign:
+        return "kAssign";
+      case BfInst::Type::kSearchZero:
+        return "kSearchZero";
+      case BfInst::Type::kAddVar:
+        return "kAddVar";
+      case BfInst::Type::kSubVar:
+        return "kSubVar";
+      case BfInst::Type::kAddCMulVar:
+        return "kAddCMulVar";
+      case BfInst::Type::kAddVarFrom:
+        return "kAddVarFrom";
+      case BfInst::Type::kSubVarFrom:
+        return "kSubVarFrom";
+      case BfInst::Type::kMovePointerAdd:
+        return "kMovePointerAdd";
+      case BfInst::Type::kAddMovePointer:
+        return "kAddMovePointer";
+      case BfInst::Type::kMovePointerAssign:
+        return "kMovePointerAssign";
+      case BfInst::Type::kAssignMovePointer:
+        return "kAssignMovePointer";
+      case BfInst::Type::kMovePointerIf:
+        return "kMovePointerIf";
+      case BfInst::Type::kMovePointerLoopEnd:
+        return "kMovePointerLoopEnd";
+      case BfInst::Type::kInfLoop:
+        return "kInfLoop";
+      case BfInst::Type::kBreakPoint:
+        return "kBreakPoint";
+      default:
+        return "kUnknown";
+    }
+  }
+
+  /*!
+   * @brief Write a part of the source code for the profile report
+   *
+   * The brainfuck commands in the part are written, and the other characters
+   * are omitted.
+   * Only the offset is written if the source code is not available.
+   * @param [in,out] os     Output stream
+   * @param [in]     begin  Offset of the first byte
+   * @param [in]     end    Offset past the last byte
    */
   void
-  compile(CompileType ct=CompileType::kIR, bool hasTopBreakPoint=false)
+  dumpSourceRange(std::ostream& os, std::size_t begin, std::size_t end) const
   {
-    switch (ct) {
-      case CompileType::kIR:
-        compileToIR(hasTopBreakPoint);
-        break;
-      case CompileType::kJit:
-        compileToIR(hasTopBreakPoint);
-        compileToNative();
+    if (end <= begin || end > bfSource.size()) {
+      os << " at source offset " << begin;
+      return;
+    }
+    os << " at source [" << begin << ", " << end << "): ";
+    std::size_t nCommands = 0;
+    for (std::string::size_type i = begin; i < end; i++) {
+      if (std::strchr("+-<>.,[]", bfSource[i]) == NULL || bfSource[i] == '\0') {
+        continue;
+      }
+      if (nCommands == kProfileSnippetSize) {
+        os << "...";
         break;
-      default:
-        assert(false);
+      }
+      os << bfSource[i];
+      nCommands++;
     }
-    state = ct;
   }
 
   /*!
-   * @brief Compile brainfuck source code to IR code
+   * @brief Append source ranges of instructions which a pass emitted for an
+   *        instruction of IR code
+   *
+   * The instructions from ranges.size() to the end of code get the source
+   * range of ircode[pc], and ones whose type differs from ircode[pc] are
+   * marked as produced by the pass.
+   * @param [in,out] ranges  Source ranges of the rewritten IR code
+   * @param [in]     code    Rewritten IR code
+   * @param [in]     pc      Index of the instruction of IR code
+   * @param [in]     origin  Name of the pass
    */
   void
-  compileToIR(bool hasTopBreakPoint=false)
+  appendSourceRanges(std::vector<SourceRange>& ranges, const std::vector<BfInst>& code,
+      std::vector<BfInst>::size_type pc, const char* origin) const
   {
-    std::stack<int> loopStack;
-    ircode.clear();
-    if (hasTopBreakPoint) {
-#ifdef BRAINFUCK_EMPLACE_AVAILABLE
-      ircode.emplace_back(BfInst::Type::kBreakPoint);
-#else
-      ircode.push_back(BfInst(BfInst::Type::kBreakPoint));
-#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+    for (std::vector<BfInst>::size_type i = ranges.size(), size = code.size(); i < size; i++) {
+      ranges.push_back(sourceRanges[pc]);
+      if (code[i].type != ircode[pc].type) {
+        ranges.back().origin = origin;
+      }
     }
-    for (std::string::size_type pc = 0; pc < bfSource.size(); pc++) {
-      switch (bfSource[pc]) {
-        case '>':
-        case '<':
-          {
-            int offset = (bfSource[pc] == '>' ? 1 : -1);
-            pc++;
-            offset += compressInstruction(pc, '>', '<');
-            if (BRAINFUCK_LIKELY(offset != 0)) {
-#ifdef BRAINFUCK_EMPLACE_AVAILABLE
-              ircode.emplace_back(BfInst::Type::kMovePointer, offset);
-#else
-              ircode.push_back(BfInst(BfInst::Type::kMovePointer, offset));
-#endif  // BRAINFUCK_EMPLACE_AVAILABLE
-            }
-          }
+  }
+
+  /*!
+   * @brief Check whether the jumps of IR code are well nested
+   *
+   * Every kLoopStart must be closed by a kLoopEnd or kMovePointerLoopEnd,
+   * every kIf and kMovePointerIf must be closed by a kEndIf, and the pair
+   * must point to each other.
+   * The body of kIf must not move the pointer, which calcMaxPointerDistance()
+   * relies on.
+   * @param [in] code  IR code
+   * @return True if the jumps are well nested, otherwise false
+   */
+  static bool
+  isValidIR(const std::vector<BfInst>& code)
+  {
+    std::stack<std::size_t> openerStack;
+    for (std::vector<BfInst>::size_type pc = 0, size = code.size(); pc < size; pc++) {
+      switch (code[pc].type) {
+        case BfInst::Type::kLoopStart:
+        case BfInst::Type::kIf:
+        case BfInst::Type::kMovePointerIf:
+          openerStack.push(pc);
           break;
-        case '+':
-        case '-':
+        case BfInst::Type::kLoopEnd:
+        case BfInst::Type::kMovePointerLoopEnd:
+        case BfInst::Type::kEndIf:
           {
-            int offset = (bfSource[pc] == '+' ? 1 : -1);
-            pc++;
-            offset += compressInstruction(pc, '+', '-');
-            if (BRAINFUCK_LIKELY(offset != 0)) {
-              if (ircode.size() > 0 && ircode[ircode.size() - 1].type == BfInst::Type::kAssign && ircode[ircode.size() - 1].op1 == 0) {
-                ircode[ircode.size() - 1].op1 = offset;
-              } else {
-#ifdef BRAINFUCK_EMPLACE_AVAILABLE
-                ircode.emplace_back(BfInst::Type::kAdd, offset);
-#else
-                ircode.push_back(BfInst(BfInst::Type::kAdd, offset));
-#endif  // BRAINFUCK_EMPLACE_AVAILABLE
-              }
+            if (openerStack.empty()
+                || static_cast<std::size_t>(code[pc].op1) != openerStack.top()
+                || static_cast<std::size_t>(code[openerStack.top()].op1) != pc) {
+              return false;
             }
+            bool isIf = code[pc].type == BfInst::Type::kEndIf;
+            if ((code[openerStack.top()].type == BfInst::Type::kLoopStart) == isIf
+                || (isIf && !isBalancedBlock(code, openerStack.top() + 1, pc))) {
+              return false;
+            }
+            openerStack.pop();
           }
           break;
-        case '.':
-#ifdef BRAINFUCK_EMPLACE_AVAILABLE
-          ircode.emplace_back(BfInst::Type::kPutchar);
-#else
-          ircode.push_back(BfInst(BfInst::Type::kPutchar));
-#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+        default:
           break;
-        case ',':
-#ifdef BRAINFUCK_EMPLACE_AVAILABLE
-          ircode.emplace_back(BfInst::Type::kGetchar);
-#else
-          ircode.push_back(BfInst(BfInst::Type::kGetchar));
-#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+      }
+    }
+    return openerStack.empty();
+  }
+
+  /*!
+   * @brief Check whether a block of IR code leaves the pointer where it was
+   *
+   * Loops in the block must not move the pointer either, and kSearchZero is
+   * not allowed.
+   * @param [in] code   IR code whose jumps in the block are well nested
+   * @param [in] begin  Index of the first instruction of the block
+   * @param [in] end    Index past the last instruction of the block
+   * @return True if the block does not move the pointer, otherwise false
+   */
+  static bool
+  isBalancedBlock(const std::vector<BfInst>& code, std::size_t begin, std::size_t end)
+  {
+    std::stack<std::int64_t> movementStack;
+    std::int64_t movement = 0;
+    for (std::size_t pc = begin; pc < end; pc++) {
+      switch (code[pc].type) {
+        case BfInst::Type::kMovePointer:
+        case BfInst::Type::kMovePointerAdd:
+        case BfInst::Type::kMovePointerAssign:
+          movement += code[pc].op1;
           break;
-        case '[':
-          loopStack.push(static_cast<int>(ircode.size()));
-#ifdef BRAINFUCK_EMPLACE_AVAILABLE
-          ircode.emplace_back(BfInst::Type::kLoopStart);
-#else
-          ircode.push_back(BfInst(BfInst::Type::kLoopStart));
-#endif  // BRAINFUCK_EMPLACE_AVAILABLE
+        case BfInst::Type::kAddMovePointer:
+        case BfInst::Type::kAssignMovePointer:
+        case BfInst::Type::kMovePointerIf:
+          movement += code[pc].op2;
           break;
-        case ']':
-          {
-            std::vector<BfInst>::size_type size = ircode.size();
-            if (size == 0) {
-              throw std::runtime_error("Unmatched ']' is detected");
-            }
-            bool isReduced = false;
-            if (size > 0 && ircode[size - 1].type == BfInst::Type::kLoopStart) {
-              isReduced = true;
-              ircode.resize(ircode.size() - 1);
-#ifdef BRAINFUCK_EMPLACE_AVAILABLE
-              ircode.emplace_back(BfInst::Type::kInfLoop);
-#else
-              ircode.push_back(BfInst(BfInst::Type::kInfLoop));
-#endif  // BRAINFUCK_EMPLACE_AVAILABLE
-            } else if (size > 1 && ircode[size - 2].type == BfInst::Type::kLoopStart) {
-              const BfInst& prevInst1 = ircode[size - 1];
-              if (prevInst1.type == BfInst::Type::kAdd && std::abs(prevInst1.op1) == 1) {
-                isReduced = true;
-                ircode.resize(ircode.size() - 2);
-#ifdef BRAINFUCK_EMPLACE_AVAILABLE
-                ircode.emplace_back(BfInst::Type::kAssign, 0);
-#else
-                ircode.push_back(BfInst(BfInst::Type::kAssign, 0));
-#endif  // BRAINFUCK_EMPLACE_AVAILABLE
-              } else if (prevInst1.type == BfInst::Type::kMovePointer) {
-                isReduced = true;
-                ircode.resize(ircode.size() - 2);
-#ifdef BRAINFUCK_EMPLACE_AVAILABLE
-                ircode.emplace_back(BfInst::Type::kSearchZero, prevInst1.op1);
-#else
-                ircode.push_back(BfInst(BfInst::Type::kSearchZero, prevInst1.op1));
-#endif  // BRAINFUCK_EMPLACE_AVAILABLE
-              }
-            } else if (size > 2) {
-              if (loopStack.empty()) {
-                throw std::runtime_error("Unmatched '[' is detected");
-              }
-              int base = loopStack.top();
-              const BfInst& prevInst1 = ircode[size - 1];
-              const BfInst& prevInst2 = ircode[size - 2];
-              const BfInst& fromInst1 = ircode[base + 1];
-              std::vector<BfInst>::size_type startIdx = -1, endIdx = -1;
-              int rollbackMove = -1;
-              if (prevInst1.type == BfInst::Type::kAdd && prevInst1.op1 == -1) {
-                startIdx = base + 1;
-                endIdx = size - 2;
-                rollbackMove = prevInst2.op1;
-              } else if (fromInst1.type == BfInst::Type::kAdd && fromInst1.op1 == -1) {
-                startIdx = base + 2;
-                endIdx = size - 1;
-                rollbackMove = prevInst1.op1;
-              }
-              if (startIdx != static_cast<std::vector<BfInst>::size_type>(-1)) {
-                std::queue<BfInst> reduceQueue;
-                int sumMove = 0;
-                for (std::vector<BfInst>::size_type i = startIdx; i < endIdx; i += 2) {
-                  const BfInst& inst1 = ircode[i];
-                  const BfInst& inst2 = ircode[i + 1];
-                  if (inst1.type == BfInst::Type::kMovePointer && inst2.type == BfInst::Type::kAdd) {
-                    sumMove += inst1.op1;
-#ifdef BRAINFUCK_EMPLACE_AVAILABLE
-                    if (inst2.op1 == 1) {
-                      reduceQueue.emplace(BfInst::Type::kAddVar, sumMove);
-                    } else if (inst2.op1 == -1) {
-                      reduceQueue.emplace(BfInst::Type::kSubVar, sumMove);
-                    } else {
-                      reduceQueue.emplace(BfInst::Type::kAddCMulVar, sumMove, inst2.op1);
-                    }
-#else
-                    if (inst2.op1 == 1) {
-                      reduceQueue.push(BfInst(BfInst::Type::kAddVar, sumMove));
-                    } else if (inst2.op1 == -1) {
-                      reduceQueue.push(BfInst(BfInst::Type::kSubVar, sumMove));
-                    } else {
-                      reduceQueue.push(BfInst(BfInst::Type::kAddCMulVar, sumMove, inst2.op1));
-                    }
-#endif  // BRAINFUCK_EMPLACE_AVAILABLE
-                  } else {
-                    sumMove = 0x7fffffff;
-                    break;
-                  }
-                }
-                if (sumMove + rollbackMove == 0) {
-                  ircode.resize(ircode.size() - reduceQueue.size() - 2);
-                  for (int i = 1; !reduceQueue.empty(); i++) {
-                    ircode[base + i] = reduceQueue.front();
-                    reduceQueue.pop();
-                  }
-#ifdef BRAINFUCK_EMPLACE_AVAILABLE
-                  ircode.emplace_back(BfInst::Type::kAssign, 0);
-                  ircode[base] = BfInst(BfInst::Type::kIf, static_cast<int>(ircode.size()));
-                  ircode.emplace_back(BfInst::Type::kEndIf, base);
-#else
-                  ircode.push_back(BfInst(BfInst::Type::kAssign, 0));
-                  ircode[base] = BfInst(BfInst::Type::kIf, static_cast<int>(ircode.size()));
-                  ircode.push_back(BfInst(BfInst::Type::kEndIf, base));
-#endif  // BRAINFUCK_EMPLACE_AVAILABLE
-                  isReduced = true;
-                }
-              }
-            }
-            if (!isReduced) {
-              ircode[static_cast<std::size_t>(loopStack.top())].op1 = static_cast<int>(ircode.size());
-#ifdef BRAINFUCK_EMPLACE_AVAILABLE
-              ircode.emplace_back(BfInst::Type::kLoopEnd, loopStack.top());
-#else
-              ircode.push_back(BfInst(BfInst::Type::kLoopEnd, loopStack.top()));
-#endif  // BRAINFUCK_EMPLACE_AVAILABLE
-            }
-            loopStack.pop();
+        case BfInst::Type::kLoopStart:
+          movementStack.push(movement);
+          movement = 0;
+          break;
+        case BfInst::Type::kMovePointerLoopEnd:
+          movement += code[pc].op2;
+          // fall through
+        case BfInst::Type::kLoopEnd:
+          if (movement != 0) {
+            return false;
           }
+          movement = movementStack.top();
+          movementStack.pop();
+          break;
+        case BfInst::Type::kSearchZero:
+          return false;
+        default:
           break;
       }
     }
-    if (!loopStack.empty()) {
-      throw std::runtime_error("Unmatched ']' is detected");
+    return movement == 0;
+  }
+
+  /*!
+   * @brief Compile IR code to packed IR code
+   *
+   * An instruction of packed IR code consists of an one-byte opcode and
+   * operands.
+   * The lower kPackedTypeBits bits of the opcode hold BfInst::Type and the
+   * upper bits hold the operand width: 8-bit, 16-bit or 32-bit, which is the
+   * escape form for large operands.
+   * Jump operands are displacements from the end of the jump instruction and
+   * precede the other operand of fused jump instructions.
+   * kEndIf is omitted and kUnknown terminates the code.
+   */
+  void
+  compileToPackedIR() BRAINFUCK_NOEXCEPT
+  {
+    std::vector<BfInst>::size_type size = ircode.size();
+    std::vector<int> widths(size, kPackedWidth8);
+    std::vector<std::size_t> positions(size + 1, 0);
+    for (std::vector<BfInst>::size_type pc = 0; pc < size; pc++) {
+      if (isJumpInstruction(ircode[pc].type)) {
+        widths[pc] = getPackedWidth(ircode[pc].op2);
+      } else {
+        widths[pc] = std::max(getPackedWidth(ircode[pc].op1), getPackedWidth(ircode[pc].op2));
+      }
+    }
+    // Widen jump operands until all displacements fit in them
+    for (bool isChanged = true; isChanged;) {
+      isChanged = false;
+      std::size_t pos = 0;
+      for (std::vector<BfInst>::size_type pc = 0; pc < size; pc++) {
+        positions[pc] = pos;
+        pos += getPackedInstSize(ircode[pc].type, widths[pc]);
+      }
+      positions[size] = pos;
+      for (std::vector<BfInst>::size_type pc = 0; pc < size; pc++) {
+        if (!isJumpInstruction(ircode[pc].type)) {
+          continue;
+        }
+        int disp = static_cast<int>(positions[static_cast<std::size_t>(ircode[pc].op1) + 1])
+          - static_cast<int>(positions[pc + 1]);
+        if (getPackedWidth(disp) > widths[pc]) {
+          widths[pc] = getPackedWidth(disp);
+          isChanged = true;
+        }
+      }
+    }
+
+    packedIRCode.clear();
+    packedIRCode.reserve(positions[size] + 1);
+    for (std::vector<BfInst>::size_type pc = 0; pc < size; pc++) {
+      const BfInst& inst = ircode[pc];
+      if (inst.type == BfInst::Type::kEndIf) {
+        continue;
+      }
+      packedIRCode.push_back(static_cast<unsigned char>(static_cast<int>(inst.type) | (widths[pc] << kPackedTypeBits)));
+      if (isJumpInstruction(inst.type)) {
+        appendPackedOperand(
+          static_cast<int>(positions[static_cast<std::size_t>(inst.op1) + 1]) - static_cast<int>(positions[pc + 1]),
+          widths[pc]);
+      } else if (getPackedOperandCount(inst.type) > 0) {
+        appendPackedOperand(inst.op1, widths[pc]);
+      }
+      if (getPackedOperandCount(inst.type) > 1) {
+        appendPackedOperand(inst.op2, widths[pc]);
+      }
+    }
+    packedIRCode.push_back(static_cast<unsigned char>(BfInst::Type::kUnknown));
+  }
+
+  /*!
+   * @brief Get an upper bound of the size of the native code of an IR
+   *        instruction
+   *
+   * The bound includes the code which writes back all the cells held in
+   * registers, and immediates and displacements of 32 bits.
+   * @param [in] type  Instruction type
+   * @return Upper bound of the size in bytes
+   */
+  static std::size_t
+  getMaxNativeCodeSize(BfInst::Type type) BRAINFUCK_NOEXCEPT
+  {
+    switch (type) {
+      case BfInst::Type::kSearchZero:
+        return 256;
+      case BfInst::Type::kGetchar:
+      case BfInst::Type::kLoopStart:
+      case BfInst::Type::kLoopEnd:
+      case BfInst::Type::kIf:
+      case BfInst::Type::kEndIf:
+      case BfInst::Type::kMovePointerIf:
+      case BfInst::Type::kMovePointerLoopEnd:
+      case BfInst::Type::kInfLoop:
+      case BfInst::Type::kBreakPoint:
+        return 128;
+      default:
+        return 64;
+    }
+  }
+
+  /*!
+   * @brief Estimate the size of the native code buffer from IR code
+   * @param [in] begin  Index of the first IR instruction to compile
+   * @param [in] end    Index past the last IR instruction to compile
+   * @return Upper bound of the size of the native code, rounded up to a power
+   *         of two so that buffers of similar programs have the same size in
+   *         CodeBufferPool
+   */
+  std::size_t
+  estimateNativeCodeSize(std::size_t begin, std::size_t end) const BRAINFUCK_NOEXCEPT
+  {
+    std::size_t size = kMaxNativeFrameCodeSize;
+    for (std::vector<BfInst>::size_type pc = begin; pc < end; pc++) {
+      size += getMaxNativeCodeSize(ircode[pc].type);
+    }
+    std::size_t bufferSize = kMinXbyakCodeGeneratorSize;
+    while (bufferSize < size) {
+      bufferSize *= 2;
     }
+    return bufferSize;
+  }
+
+  /*!
+   * @brief Get the number of bytes which native code keeps in its output
+   *        buffer before passing them to the output sink
+   * @return The number of bytes
+   */
+  int
+  getJitOutputLimit() const BRAINFUCK_NOEXCEPT
+  {
+    return static_cast<int>(std::min(outputSink->getFlushBytes(), static_cast<std::size_t>(kJitOutputBufferSize)));
   }
 
   void
   compileToNative() BRAINFUCK_NOEXCEPT
   {
+    compileToNative(0, ircode.size(), false);
+  }
+
+  /*!
+   * @brief Compile a range of IR code to native code in cg
+   *
+   * The native code of a loop skips the newline which the native code of a
+   * whole program writes at exit, and returns the pointer after the loop.
+   * @param [in] begin   Index of the first IR instruction to compile
+   * @param [in] end     Index past the last IR instruction to compile
+   * @param [in] isLoop  True if the range is a loop from kLoopStart to the
+   *                     instruction which closes it
+   */
+  void
+  compileToNative(std::size_t begin, std::size_t end, bool isLoop) BRAINFUCK_NOEXCEPT
+  {
+    // Return the previous buffer to the pool before taking a new one
     cg.reset();
+    // The buffer grows if the estimate is exceeded
+    cg.reset(new Xbyak::CodeGenerator(estimateNativeCodeSize(begin, end), Xbyak::AutoGrow, &CodeBufferPool::getInstance(useHugePages)));
+    // The output buffer is on the native stack, and outIndex counts up from
+    // -outLimit to zero, where the buffer is passed to the output sink
+    const int outLimit = getJitOutputLimit();
 #ifdef XBYAK32
-    const Xbyak::Reg32& pPutchar(cg.esi);
-    const Xbyak::Reg32& pGetchar(cg.edi);
-    const Xbyak::Reg32& stack(cg.ebp);
-    const Xbyak::Address cur = Xbyak::util::byte[stack];
-    cg.push(cg.ebp);  // stack
-    cg.push(cg.esi);
-    cg.push(cg.edi);
-    const int P_ = 4 * 3;
-    cg.mov(pPutchar, Xbyak::util::ptr[cg.esp + P_ + 4]);  // putchar
-    cg.mov(pGetchar, Xbyak::util::ptr[cg.esp + P_ + 8]);  // getchar
-    cg.mov(stack, Xbyak::util::ptr[cg.esp + P_ + 12]);  // stack
+    const Xbyak::Reg32& pWrite(cg->esi);
+    const Xbyak::Reg32& pRead(cg->edi);
+    const Xbyak::Reg32& stack(cg->ebp);
+    const Xbyak::Reg32& outIndex(cg->ebx);
+    const Xbyak::Address cur = getCellFrame()[stack];
+    const Xbyak::Address outCur = Xbyak::util::byte[cg->esp + outIndex + outLimit];
+    cg->push(cg->ebp);  // stack
+    cg->push(cg->esi);
+    cg->push(cg->edi);
+    cg->push(cg->ebx);
+    const int P_ = 4 * 4;
+    cg->mov(pWrite, Xbyak::util::ptr[cg->esp + P_ + 4]);  // writeJitOutput
+    cg->mov(pRead, Xbyak::util::ptr[cg->esp + P_ + 8]);  // readJitInput
+    cg->mov(stack, Xbyak::util::ptr[cg->esp + P_ + 12]);  // stack
+    cg->sub(cg->esp, kJitOutputBufferSize);
+    // The output sink stays in the argument
+    const int sinkOffset = kJitOutputBufferSize + P_ + 16;
 #elif defined(XBYAK64_WIN)
-    const Xbyak::Reg64& pPutchar(cg.rsi);
-    const Xbyak::Reg64& pGetchar(cg.rdi);
-    const Xbyak::Reg64& stack(cg.rbp);  // stack
-    const Xbyak::Address cur = Xbyak::util::byte[stack];
-    cg.push(cg.rsi);
-    cg.push(cg.rdi);
-    cg.push(cg.rbp);
-    cg.mov(pPutchar, cg.rcx);  // putchar
-    cg.mov(pGetchar, cg.rdx);  // getchar
-    cg.mov(stack, cg.r8);  // stack
+    const Xbyak::Reg64& pWrite(cg->rsi);
+    const Xbyak::Reg64& pRead(cg->rdi);
+    const Xbyak::Reg64& stack(cg->rbp);  // stack
+    const Xbyak::Reg64& outIndex(cg->r12);
+    const Xbyak::Address cur = getCellFrame()[stack];
+    const Xbyak::Address outCur = Xbyak::util::byte[cg->rsp + outIndex + outLimit];
+    cg->push(cg->rsi);
+    cg->push(cg->rdi);
+    cg->push(cg->rbp);
+    cg->push(cg->r12);
+    cg->mov(pWrite, cg->rcx);  // writeJitOutput
+    cg->mov(pRead, cg->rdx);  // readJitInput
+    cg->mov(stack, cg->r8);  // stack
+    cg->sub(cg->rsp, kJitOutputBufferSize + 8);
+    // The output sink is kept above the output buffer
+    const int sinkOffset = kJitOutputBufferSize;
+    cg->mov(Xbyak::util::ptr[cg->rsp + sinkOffset], cg->r9);
 #else
-    const Xbyak::Reg64& pPutchar(cg.rbx);
-    const Xbyak::Reg64& pGetchar(cg.rbp);
-    const Xbyak::Reg64& stack(cg.r12);  // stack
-    const Xbyak::Address cur = Xbyak::util::byte[stack];
-    cg.push(cg.rbx);
-    cg.push(cg.rbp);
-    cg.push(cg.r12);
-    cg.mov(pPutchar, cg.rdi);  // putchar
-    cg.mov(pGetchar, cg.rsi);  // getchar
-    cg.mov(stack, cg.rdx);  // stack
+    const Xbyak::Reg64& pWrite(cg->rbx);
+    const Xbyak::Reg64& pRead(cg->rbp);
+    const Xbyak::Reg64& stack(cg->r12);  // stack
+    const Xbyak::Reg64& outIndex(cg->r13);
+    const Xbyak::Address cur = getCellFrame()[stack];
+    const Xbyak::Address outCur = Xbyak::util::byte[cg->rsp + outIndex + outLimit];
+    cg->push(cg->rbx);
+    cg->push(cg->rbp);
+    cg->push(cg->r12);
+    cg->push(cg->r13);
+    cg->mov(pWrite, cg->rdi);  // writeJitOutput
+    cg->mov(pRead, cg->rsi);  // readJitInput
+    cg->mov(stack, cg->rdx);  // stack
+    cg->sub(cg->rsp, kJitOutputBufferSize + 8);
+    // The output sink is kept above the output buffer
+    const int sinkOffset = kJitOutputBufferSize;
+    cg->mov(Xbyak::util::ptr[cg->rsp + sinkOffset], cg->rcx);
 #endif  // XBYAK32
+    cg->mov(outIndex, -outLimit);
+    Xbyak::Label flushLabel;
     int labelNo = 0;
     std::stack<int> keepLabelNo;
-#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
-    for (const auto& inst : ircode) {
-#else
-    for (std::vector<BfInst>::const_iterator itr__ = ircode.begin(); itr__ != ircode.end(); ++itr__) {
-      const BfInst& inst = *itr__;
-#endif
+    // Cells are kept in registers in straight-line code
+    CellCache cache;
+    for (std::vector<BfInst>::size_type pc = begin; pc < end; pc++) {
+      const BfInst& inst = ircode[pc];
       switch (inst.type) {
         case BfInst::Type::kMovePointer:
-          if (inst.op1 > 0) {
-            if (inst.op1 == 1) {
-              cg.inc(stack);
-            } else {
-              cg.add(stack, inst.op1);
-            }
-          } else if (inst.op1 < 0) {
-            if (inst.op1 == -1) {
-              cg.dec(stack);
-            } else {
-              cg.sub(stack, -inst.op1);
-            }
-          }
+          emitNativeMovePointer(cache, stack, inst.op1);
           break;
         case BfInst::Type::kAdd:
-          if (inst.op1 > 0) {
-            if (inst.op1 == 1) {
-              cg.inc(cur);
-            } else {
-              cg.add(cur, inst.op1);
-            }
-          } else if (inst.op1 < 0) {
-            if (inst.op1 == -1) {
-              cg.dec(cur);
-            } else {
-              cg.sub(cur, -inst.op1);
-            }
-          }
+          emitNativeAdd(emitNativeWriteCell(cache, stack, inst.op2, true, inst.op2), inst.op1);
           break;
         case BfInst::Type::kPutchar:
+          emitNativePutchar(outCur, outIndex,
+              getCellRegister(emitNativeCacheCell(cache, stack, inst.op1, true, inst.op1), 8), flushLabel, labelNo);
+          break;
+        case BfInst::Type::kGetchar:
+          // readJitInput() takes the output buffer, and flushes it only if the
+          // input may block
+          emitNativeFlushCells(cache, stack);
 #ifdef XBYAK32
-          cg.push(cur);
-          cg.call(pPutchar);
-          cg.pop(cg.eax);
+          cg->push(Xbyak::util::dword[cg->esp + sinkOffset]);
+          cg->lea(cg->eax, Xbyak::util::ptr[outIndex + outLimit]);
+          cg->push(cg->eax);
+          cg->lea(cg->eax, Xbyak::util::ptr[cg->esp + 4 * 2]);
+          cg->push(cg->eax);
+          cg->call(pRead);
+          cg->add(cg->esp, 4 * 3);
 #elif defined(XBYAK64_WIN)
-          cg.mov(cg.rcx, cur);
-          cg.sub(cg.rsp, 32);
-          cg.call(pPutchar);
-          cg.add(cg.rsp, 32);
+          cg->sub(cg->rsp, 32);
+          cg->lea(cg->rcx, Xbyak::util::ptr[cg->rsp + 32]);
+          cg->lea(cg->rdx, Xbyak::util::ptr[outIndex + outLimit]);
+          cg->mov(cg->r8, Xbyak::util::ptr[cg->rsp + 32 + sinkOffset]);
+          cg->call(pRead);
+          cg->add(cg->rsp, 32);
 #else
-          cg.mov(cg.rdi, cur);
-          cg.call(pPutchar);
+          cg->mov(cg->rdi, cg->rsp);
+          cg->lea(cg->rsi, Xbyak::util::ptr[outIndex + outLimit]);
+          cg->mov(cg->rdx, Xbyak::util::ptr[cg->rsp + sinkOffset]);
+          cg->call(pRead);
 #endif  // XBYAK32
+          cg->mov(outIndex, -outLimit);
+          if (cellBits != 8) {
+            cg->movzx(cg->eax, cg->al);
+          }
+          cg->mov(getCellFrame()[stack + inst.op1 * (cellBits / 8)], getCellAccumulator());
           break;
-        case BfInst::Type::kGetchar:
-#ifdef XBYAK64_WIN
-          cg.sub(cg.rsp, 32);
-#endif  // XBYAK64_WIN
-          cg.call(pGetchar);
-#ifdef XBYAK64_WIN
-          cg.add(cg.rsp, 32);
-#endif  // XBYAK64_WIN
-          cg.mov(cur, cg.al);
-          break;
+        case BfInst::Type::kMovePointerIf:
+          emitNativeMovePointer(cache, stack, inst.op2);
+          // fall through
         case BfInst::Type::kLoopStart:
         case BfInst::Type::kIf:
-          cg.L(toXbyakLabelString(labelNo, XbyakDirection::B));
-          cg.mov(cg.al, cur);
-          cg.test(cg.al, cg.al);
-          cg.jz(toXbyakLabelString(labelNo, XbyakDirection::F), Xbyak::CodeGenerator::T_NEAR);
-          keepLabelNo.push(labelNo++);
+          {
+            int index = findCachedCell(cache, 0);
+            emitNativeFlushCells(cache, stack);
+            if (index == -1) {
+              cg->mov(getCellAccumulator(), cur);
+              cg->test(getCellAccumulator(), getCellAccumulator());
+            } else {
+              cg->test(getCellRegister(index), getCellRegister(index));
+            }
+            cg->jz(toXbyakLabelString(labelNo, XbyakDirection::F), Xbyak::CodeGenerator::T_NEAR);
+            // Loop body, to which kLoopEnd jumps back after its own test
+            cg->L(toXbyakLabelString(labelNo, XbyakDirection::B));
+            keepLabelNo.push(labelNo++);
+          }
           break;
+        case BfInst::Type::kMovePointerLoopEnd:
+          emitNativeMovePointer(cache, stack, inst.op2);
+          // fall through
         case BfInst::Type::kLoopEnd:
           {
+            int index = findCachedCell(cache, 0);
+            emitNativeFlushCells(cache, stack);
+            if (index == -1) {
+              cg->mov(getCellAccumulator(), cur);
+              cg->test(getCellAccumulator(), getCellAccumulator());
+            } else {
+              cg->test(getCellRegister(index), getCellRegister(index));
+            }
             int no = keepLabelNo.top();
             keepLabelNo.pop();
-            cg.jmp(toXbyakLabelString(no, XbyakDirection::B));
-            cg.L(toXbyakLabelString(no, XbyakDirection::F));
+            cg->jnz(toXbyakLabelString(no, XbyakDirection::B), Xbyak::CodeGenerator::T_NEAR);
+            cg->L(toXbyakLabelString(no, XbyakDirection::F));
           }
           break;
         case BfInst::Type::kEndIf:
+          emitNativeFlushCells(cache, stack);
           {
             int no = keepLabelNo.top();
             keepLabelNo.pop();
-            cg.L(toXbyakLabelString(no, XbyakDirection::F));
+            cg->L(toXbyakLabelString(no, XbyakDirection::F));
           }
           break;
         case BfInst::Type::kAssign:
-          cg.mov(cur, inst.op1);
+          cg->mov(emitNativeWriteCell(cache, stack, inst.op2, false, inst.op2), toCellValue(static_cast<std::uint64_t>(inst.op1)));
           break;
         case BfInst::Type::kSearchZero:
-          // kLoopStart
-          cg.L(toXbyakLabelString(labelNo, XbyakDirection::B));
-          cg.mov(cg.al, cur);
-          cg.test(cg.al, cg.al);
-          cg.jz(toXbyakLabelString(labelNo, XbyakDirection::F), Xbyak::CodeGenerator::T_NEAR);
-          // kNextN / kPrevN
-          if (inst.op1 > 0) {
-            if (inst.op1 == 1) {
-              cg.inc(stack);
-            } else {
-              cg.add(stack, inst.op1);
-            }
-          } else if (inst.op1 < 0) {
-            if (inst.op1 == -1) {
-              cg.dec(stack);
+          emitNativeFlushCells(cache, stack);
+          emitNativeSearchZero(stack, inst.op1, labelNo);
+          break;
+        case BfInst::Type::kAddVar:
+          {
+            const Xbyak::Reg& src = emitNativeReadCell(cache, stack, 0);
+            cg->add(emitNativeWriteCell(cache, stack, inst.op1, true, 0), src);
+          }
+          break;
+        case BfInst::Type::kSubVar:
+          {
+            const Xbyak::Reg& src = emitNativeReadCell(cache, stack, 0);
+            cg->sub(emitNativeWriteCell(cache, stack, inst.op1, true, 0), src);
+          }
+          break;
+        case BfInst::Type::kAddCMulVar:
+          {
+            const Xbyak::Reg& src = emitNativeReadCell(cache, stack, 0);
+            const Xbyak::Reg& dst = emitNativeWriteCell(cache, stack, inst.op1, true, 0);
+            if (cellBits == 8) {
+              cg->mov(cg->al, inst.op2);
+              cg->mul(src);
             } else {
-              cg.sub(stack, -inst.op1);
+              cg->imul(getCellAccumulator(), src, toCellValue(static_cast<std::uint64_t>(inst.op2)));
             }
+            cg->add(dst, getCellAccumulator());
+          }
+          break;
+        case BfInst::Type::kAddVarFrom:
+          {
+            const Xbyak::Reg& src = emitNativeReadCell(cache, stack, inst.op2);
+            cg->add(emitNativeWriteCell(cache, stack, inst.op1, true, inst.op2), src);
           }
-          // kLoopEnd
-          cg.jmp(toXbyakLabelString(labelNo, XbyakDirection::B));
-          cg.L(toXbyakLabelString(labelNo, XbyakDirection::F));
-          labelNo++;
           break;
-        case BfInst::Type::kAddVar:
-          cg.mov(cg.al, cur);
-          cg.add(Xbyak::util::byte[stack + inst.op1], cg.al);
+        case BfInst::Type::kSubVarFrom:
+          {
+            const Xbyak::Reg& src = emitNativeReadCell(cache, stack, inst.op2);
+            cg->sub(emitNativeWriteCell(cache, stack, inst.op1, true, inst.op2), src);
+          }
           break;
-        case BfInst::Type::kSubVar:
-          cg.mov(cg.al, cur);
-          cg.sub(Xbyak::util::byte[stack + inst.op1], cg.al);
+        case BfInst::Type::kMovePointerAdd:
+          emitNativeMovePointer(cache, stack, inst.op1);
+          emitNativeAdd(emitNativeWriteCell(cache, stack, 0, true, 0), inst.op2);
           break;
-        case BfInst::Type::kAddCMulVar:
-          cg.mov(cg.al, inst.op2);
-          cg.mul(cur);
-          cg.add(Xbyak::util::byte[stack + inst.op1], cg.al);
+        case BfInst::Type::kAddMovePointer:
+          emitNativeAdd(emitNativeWriteCell(cache, stack, 0, true, 0), inst.op1);
+          emitNativeMovePointer(cache, stack, inst.op2);
+          break;
+        case BfInst::Type::kMovePointerAssign:
+          emitNativeMovePointer(cache, stack, inst.op1);
+          cg->mov(emitNativeWriteCell(cache, stack, 0, false, 0), toCellValue(static_cast<std::uint64_t>(inst.op2)));
+          break;
+        case BfInst::Type::kAssignMovePointer:
+          cg->mov(emitNativeWriteCell(cache, stack, 0, false, 0), toCellValue(static_cast<std::uint64_t>(inst.op1)));
+          emitNativeMovePointer(cache, stack, inst.op2);
           break;
         case BfInst::Type::kInfLoop:
+          emitNativeFlushCells(cache, stack);
           // if (cur != 0)
-          cg.mov(cg.al, cur);
-          cg.test(cg.al, cg.al);
-          cg.jz(toXbyakLabelString(labelNo, XbyakDirection::F), Xbyak::CodeGenerator::T_NEAR);
+          cg->mov(getCellAccumulator(), cur);
+          cg->test(getCellAccumulator(), getCellAccumulator());
+          cg->jz(toXbyakLabelString(labelNo, XbyakDirection::F), Xbyak::CodeGenerator::T_NEAR);
           // infinite loop
-          cg.L(toXbyakLabelString(labelNo, XbyakDirection::B));
-          cg.jmp(toXbyakLabelString(labelNo, XbyakDirection::B));
+          cg->L(toXbyakLabelString(labelNo, XbyakDirection::B));
+          cg->jmp(toXbyakLabelString(labelNo, XbyakDirection::B));
           // endif
-          cg.L(toXbyakLabelString(labelNo, XbyakDirection::F));
+          cg->L(toXbyakLabelString(labelNo, XbyakDirection::F));
           labelNo++;
           break;
         case BfInst::Type::kBreakPoint:
-          cg.db(0xcc);
+          emitNativeFlushCells(cache, stack);
+          cg->db(0xcc);
           break;
         default:
           assert(false);
       }
     }
+    if (!isLoop) {
+      // Cached cells are stored even though they are dead, so that an access
+      // out of the tape is detected as in the other engines
+      emitNativeFlushCells(cache, stack);
+      cg->mov(cg->al, '\n');
+      emitNativePutchar(outCur, outIndex, cg->al, flushLabel, labelNo);
+    }
+    cg->call(flushLabel);
 #ifdef XBYAK32
-    cg.push('\n');
-    cg.call(pPutchar);
-    cg.pop(cg.eax);
-    cg.pop(cg.edi);
-    cg.pop(cg.esi);
-    cg.pop(cg.ebp);
-#elif defined(XBYAK64_WIN)
-    cg.mov(cg.rcx, '\n');
-    cg.sub(cg.rsp, 32);
-    cg.call(pPutchar);
-    cg.add(cg.rsp, 32);
-    cg.pop(cg.rbp);
-    cg.pop(cg.rdi);
-    cg.pop(cg.rsi);
+    if (isLoop) {
+      cg->mov(cg->eax, stack);
+    }
+    cg->add(cg->esp, kJitOutputBufferSize);
+    cg->pop(cg->ebx);
+    cg->pop(cg->edi);
+    cg->pop(cg->esi);
+    cg->pop(cg->ebp);
+#else
+    if (isLoop) {
+      cg->mov(cg->rax, stack);
+    }
+#  ifdef XBYAK64_WIN
+    cg->add(cg->rsp, kJitOutputBufferSize + 8);
+    cg->pop(cg->r12);
+    cg->pop(cg->rbp);
+    cg->pop(cg->rdi);
+    cg->pop(cg->rsi);
+#  else
+    cg->add(cg->rsp, kJitOutputBufferSize + 8);
+    cg->pop(cg->r13);
+    cg->pop(cg->r12);
+    cg->pop(cg->rbp);
+    cg->pop(cg->rbx);
+#  endif  // XBYAK64_WIN
+#endif  // XBYAK32
+    cg->ret();
+
+    // Subroutine which passes the output buffer to writeJitOutput() and empties
+    // it, preserving the registers which hold cells
+    cg->L(flushLabel);
+#ifdef XBYAK32
+    cg->push(cg->ecx);
+    cg->push(cg->edx);
+    cg->push(Xbyak::util::dword[cg->esp + 4 * 3 + sinkOffset]);
+    cg->lea(cg->eax, Xbyak::util::ptr[outIndex + outLimit]);
+    cg->push(cg->eax);
+    cg->lea(cg->eax, Xbyak::util::ptr[cg->esp + 4 * 5]);
+    cg->push(cg->eax);
+    cg->call(pWrite);
+    cg->add(cg->esp, 4 * 3);
+    cg->pop(cg->edx);
+    cg->pop(cg->ecx);
 #else
-    cg.mov(cg.rdi, '\n');
-    cg.call(pPutchar);
-    cg.pop(cg.r12);
-    cg.pop(cg.rbp);
-    cg.pop(cg.rbx);
+    cg->push(cg->rcx);
+    cg->push(cg->rdx);
+    cg->push(cg->r8);
+    cg->push(cg->r9);
+    cg->push(cg->r10);
+    cg->push(cg->r11);
+#  ifdef XBYAK64_WIN
+    cg->sub(cg->rsp, 32 + 8);
+    cg->lea(cg->rcx, Xbyak::util::ptr[cg->rsp + 32 + 8 + 8 * 6 + 8]);
+    cg->lea(cg->rdx, Xbyak::util::ptr[outIndex + outLimit]);
+    cg->mov(cg->r8, Xbyak::util::ptr[cg->rsp + 32 + 8 + 8 * 6 + 8 + sinkOffset]);
+    cg->call(pWrite);
+    cg->add(cg->rsp, 32 + 8);
+#  else
+    cg->sub(cg->rsp, 8);
+    cg->lea(cg->rdi, Xbyak::util::ptr[cg->rsp + 8 + 8 * 6 + 8]);
+    cg->lea(cg->rsi, Xbyak::util::ptr[outIndex + outLimit]);
+    cg->mov(cg->rdx, Xbyak::util::ptr[cg->rsp + 8 + 8 * 6 + 8 + sinkOffset]);
+    cg->call(pWrite);
+    cg->add(cg->rsp, 8);
+#  endif  // XBYAK64_WIN
+    cg->pop(cg->r11);
+    cg->pop(cg->r10);
+    cg->pop(cg->r9);
+    cg->pop(cg->r8);
+    cg->pop(cg->rdx);
+    cg->pop(cg->rcx);
 #endif  // XBYAK32
-    cg.ret();
+    cg->mov(outIndex, -outLimit);
+    cg->ret();
+
+    // Resolve the labels in the grown buffer, and release the pages which
+    // the code does not use
+    cg->ready();
+    CodeBufferPool::getInstance(useHugePages).discardUnused(cg->getCode(), cg->getSize());
+    cg->setProtectModeRE();
   }
 
   /*!
    * @brief Execute brainfuck
-   * @param [in] heapSize  Heap size for execution
+   *
+   * The heap is a Tape, so its cells are committed as they are touched, and
+   * an access out of the heap is reported as an exception.
+   * A tape overflow jumps out of the engine with siglongjmp(), so the frames
+   * of the engines must not own objects with non-trivial destructors.
+   * @param [in] heapSize  Heap size for execution in cells
    */
   void
-  execute(std::size_t heapSize=kDefaultHeapSize) const BRAINFUCK_NOEXCEPT
+  execute(std::size_t heapSize=kDefaultHeapSize)
   {
-#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
-    std::unique_ptr<unsigned char[]> heap(new unsigned char[heapSize]);
-    std::fill_n(heap.get(), heapSize, 0);
-    prefetch<1, 3>(heap.get(), heapSize);
-    switch (state) {
-      case CompileType::kIR:
-        executeIR(heap.get());
+    const std::ptrdiff_t cellSize = cellBits / 8;
+    Tape tape(heapSize * static_cast<std::size_t>(cellSize), isBidirectionalTape, useHugePages,
+        calcMaxPointerDistance() * static_cast<std::size_t>(cellSize));
+#if defined(BRAINFUCK_JIT_OUTPUT_RECOVERY_AVAILABLE)
+    stagedJitOutputSize = 0;
+    if (state == CompileType::kJit || state == CompileType::kTiered) {
+      stagedJitOutput.resize(kJitOutputBufferSize);
+      tape.setOverflowHandler(saveStagedJitOutput, this);
+    }
+#endif  // defined(BRAINFUCK_JIT_OUTPUT_RECOVERY_AVAILABLE)
+#if defined(TAPE_OVERFLOW_CHECK_AVAILABLE)
+    if (sigsetjmp(tape.getOverflowJumpBuffer(), 1) != 0) {
+#  if defined(BRAINFUCK_JIT_OUTPUT_RECOVERY_AVAILABLE)
+      if (stagedJitOutputSize > 0) {
+        outputSink->write(&stagedJitOutput[0], stagedJitOutputSize);
+      }
+#  endif  // defined(BRAINFUCK_JIT_OUTPUT_RECOVERY_AVAILABLE)
+      outputSink->flush();
+      // The offset of the faulting byte is rounded down to the cell
+      std::ptrdiff_t offset = tape.getOverflowOffset();
+      std::ostringstream oss;
+      oss << "Tape overflow at cell " << (offset < 0 ? offset - (cellSize - 1) : offset) / cellSize;
+      throw std::runtime_error(oss.str());
+    }
+#endif  // defined(TAPE_OVERFLOW_CHECK_AVAILABLE)
+    writePrefixOutput();
+    switch (cellBits) {
+      case 16:
+        executeCells(reinterpret_cast<std::uint16_t*>(tape.get()));
         break;
-      case CompileType::kJit:
-        executeJit(heap.get());
+      case 32:
+        executeCells(reinterpret_cast<std::uint32_t*>(tape.get()));
         break;
-      case CompileType::kUnknown:
-        execute(heap.get());
+      case 64:
+        executeCells(reinterpret_cast<std::uint64_t*>(tape.get()));
+        break;
+      default:
+        executeCells(tape.get());
         break;
     }
+  }
+
+#if defined(BRAINFUCK_JIT_OUTPUT_RECOVERY_AVAILABLE)
+  /*!
+   * @brief Save the output buffer of native code which accessed a cell out
+   *        of the tape
+   *
+   * This is called in the signal handler of the tape.
+   * The output buffer is at the stack pointer of the native code, and the
+   * register outIndex of compileToNative() tells how many bytes it holds.
+   * Nothing is saved if the fault is not in native code.
+   * @param [in] context  ucontext_t of the faulting access
+   * @param [in] arg      This Brainfuck object
+   */
+  static void
+  saveStagedJitOutput(void* context, void* arg) BRAINFUCK_NOEXCEPT
+  {
+    Brainfuck* bf = static_cast<Brainfuck*>(arg);
+    const greg_t* regs = static_cast<const ucontext_t*>(context)->uc_mcontext.gregs;
+#ifdef XBYAK32
+    const Xbyak::uint8* ip = reinterpret_cast<const Xbyak::uint8*>(regs[REG_EIP]);
+    const unsigned char* buffer = reinterpret_cast<const unsigned char*>(regs[REG_ESP]);
+    std::ptrdiff_t size = regs[REG_EBX] + bf->getJitOutputLimit();
 #else
-    unsigned char* heap = new unsigned char[heapSize];
-    std::fill_n(heap, heapSize, 0);
-    prefetch<1, 3>(heap, heapSize);
+    const Xbyak::uint8* ip = reinterpret_cast<const Xbyak::uint8*>(regs[REG_RIP]);
+    const unsigned char* buffer = reinterpret_cast<const unsigned char*>(regs[REG_RSP]);
+    std::ptrdiff_t size = regs[REG_R13] + bf->getJitOutputLimit();
+#endif  // XBYAK32
+    bool isInNativeCode = bf->nativeLoops.get() != NULL ? bf->nativeLoops->contains(ip)
+      : bf->getNativeCode() <= ip && ip < bf->getNativeCode() + bf->getNativeCodeSize();
+    if (isInNativeCode && 0 < size && size <= bf->getJitOutputLimit()) {
+      std::memcpy(&bf->stagedJitOutput[0], buffer, static_cast<std::size_t>(size));
+      bf->stagedJitOutputSize = static_cast<std::size_t>(size);
+    }
+  }
+#endif  // defined(BRAINFUCK_JIT_OUTPUT_RECOVERY_AVAILABLE)
+
+  /*!
+   * @brief Calculate the largest distance of the pointer between two accesses
+   *        to the tape, which the guard regions of the tape must cover
+   *
+   * IR code is split into straight-line blocks at instructions which test the
+   * current cell.
+   * Every access in a block is within the distance from the cell tested at
+   * the start of the block, even if native code reorders the accesses.
+   * The body of kIf does not move the pointer, so kEndIf is at the cell
+   * tested by kIf.
+   * If IR code is not kept because native code is mapped from the on-disk
+   * cache, the distance is bounded by the number of pointer movements in the
+   * source code and the memory budget of compile-time execution.
+   * @return Distance in cells
+   */
+  std::size_t
+  calcMaxPointerDistance() const BRAINFUCK_NOEXCEPT
+  {
+    std::size_t maxDistance = 0;
+    if (state == CompileType::kUnknown) {
+      // Every command except pointer movement accesses the current cell
+      std::size_t distance = 0;
+      for (std::string::size_type pc = 0; pc < bfSource.size(); pc++) {
+        switch (bfSource[pc]) {
+          case '>':
+          case '<':
+            maxDistance = std::max(maxDistance, ++distance);
+            break;
+          case '+':
+          case '-':
+          case '.':
+          case ',':
+          case '[':
+          case ']':
+            distance = 0;
+            break;
+        }
+      }
+      return maxDistance;
+    }
+    if (cachedCode.get() != NULL && ircode.empty()) {
+      return static_cast<std::size_t>(std::count(bfSource.begin(), bfSource.end(), '>')
+          + std::count(bfSource.begin(), bfSource.end(), '<')) + evalMemoryLimit;
+    }
+    // Position of the pointer from the cell tested at the start of the block
+    std::int64_t pointer = 0;
+    for (std::vector<BfInst>::size_type pc = 0, size = ircode.size(); pc < size; pc++) {
+      const BfInst& inst = ircode[pc];
+      switch (inst.type) {
+        case BfInst::Type::kMovePointer:
+          pointer += inst.op1;
+          break;
+        case BfInst::Type::kAdd:
+        case BfInst::Type::kAssign:
+          updateMaxDistance(maxDistance, pointer + inst.op2);
+          break;
+        case BfInst::Type::kPutchar:
+        case BfInst::Type::kGetchar:
+          updateMaxDistance(maxDistance, pointer + inst.op1);
+          break;
+        case BfInst::Type::kAddVar:
+        case BfInst::Type::kSubVar:
+        case BfInst::Type::kAddCMulVar:
+          updateMaxDistance(maxDistance, pointer);
+          updateMaxDistance(maxDistance, pointer + inst.op1);
+          break;
+        case BfInst::Type::kAddVarFrom:
+        case BfInst::Type::kSubVarFrom:
+          updateMaxDistance(maxDistance, pointer + inst.op1);
+          updateMaxDistance(maxDistance, pointer + inst.op2);
+          break;
+        case BfInst::Type::kMovePointerAdd:
+        case BfInst::Type::kMovePointerAssign:
+          pointer += inst.op1;
+          updateMaxDistance(maxDistance, pointer);
+          break;
+        case BfInst::Type::kAddMovePointer:
+        case BfInst::Type::kAssignMovePointer:
+          updateMaxDistance(maxDistance, pointer);
+          pointer += inst.op2;
+          break;
+        case BfInst::Type::kMovePointerIf:
+        case BfInst::Type::kMovePointerLoopEnd:
+          pointer += inst.op2;
+          updateMaxDistance(maxDistance, pointer);
+          pointer = 0;
+          break;
+        case BfInst::Type::kSearchZero:
+          updateMaxDistance(maxDistance, pointer);
+          updateMaxDistance(maxDistance, inst.op1);
+          pointer = 0;
+          break;
+        case BfInst::Type::kLoopStart:
+        case BfInst::Type::kLoopEnd:
+        case BfInst::Type::kIf:
+        case BfInst::Type::kEndIf:
+        case BfInst::Type::kInfLoop:
+          updateMaxDistance(maxDistance, pointer);
+          pointer = 0;
+          break;
+        default:
+          break;
+      }
+    }
+    return maxDistance;
+  }
+
+  /*!
+   * @brief Update the largest distance of the pointer with an access
+   * @param [in,out] maxDistance  The largest distance
+   * @param [in]     offset       Offset of the accessed cell from the cell
+   *                              tested at the start of the block
+   */
+  static void
+  updateMaxDistance(std::size_t& maxDistance, std::int64_t offset) BRAINFUCK_NOEXCEPT
+  {
+    std::size_t distance = static_cast<std::size_t>(offset < 0 ? -offset : offset);
+    if (distance > maxDistance) {
+      maxDistance = distance;
+    }
+  }
+
+  /*!
+   * @brief Execute brainfuck with the compiled engine on a heap of the given
+   *        cell type
+   * @tparam CellT  Cell type
+   * @param [in,out] heap  Pointer to heap memory
+   */
+  template<typename CellT>
+  void
+  executeCells(CellT* heap)
+  {
     switch (state) {
       case CompileType::kIR:
-        executeIR(heap);
+        switch (dispatchType) {
+          case DispatchType::kSwitch:
+            if (isProfiled) {
+              profileCounts.assign(ircode.size(), 0);
+              executeIR<true, false>(heap, profileCounts.empty() ? NULL : &profileCounts[0]);
+            } else {
+              executeIR<false, false>(heap, NULL);
+            }
+            break;
+          case DispatchType::kThreaded:
+            executeIRThreaded(heap);
+            break;
+          case DispatchType::kPacked:
+            executePackedIR(heap);
+            break;
+        }
         break;
       case CompileType::kJit:
         executeJit(heap);
         break;
+      case CompileType::kTiered:
+        executeIR<false, true>(heap, NULL);
+        break;
       case CompileType::kUnknown:
         execute(heap);
         break;
     }
-    delete[] heap;
-#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
   }
 
   /*!
    * @brief Execute brainfuck using given heap
    * @param [in,out] heap  Pointer to heap memory
    */
+  template<typename CellT>
   void
-  execute(unsigned char* heap) const BRAINFUCK_NOEXCEPT
+  execute(CellT* heap) const BRAINFUCK_NOEXCEPT
   {
     std::size_t hp = 0;
     prefetch<0, 3>(&bfSource[0], bfSource.length() + 1);
@@ -911,11 +4567,10 @@ public:
           hp--;
           break;
         case '.':
-          std::cout.put(static_cast<char>(heap[hp]));
+          outputSink->put(static_cast<unsigned char>(heap[hp]));
           break;
         case ',':
-          std::cout.flush();
-          heap[hp] = static_cast<unsigned char>(std::cin.get());
+          heap[hp] = static_cast<CellT>(static_cast<unsigned char>(readInput()));
           break;
         case '[':
           if (BRAINFUCK_LIKELY(heap[hp] == 0)) {
@@ -951,42 +4606,70 @@ public:
           break;
       }
     }
-    std::cout.put('\n');
-    std::cout.flush();
+    outputSink->put('\n');
+    outputSink->flush();
   }
 
   /*!
    * @brief Execute IR code
-   * @param [in,out] heap  Pointer to heap memory
+   *
+   * In tiered execution, taken back edges of each loop are counted, and a
+   * loop is compiled to native code when the count reaches
+   * kHotLoopThreshold.
+   * Execution enters the native code at the loop header at once, since the
+   * cell is not zero at a taken back edge, and returns to IR code after the
+   * loop.
+   * Later entries of the loop also run the native code.
+   * @tparam IsProfiled  Count executions of each instruction; the counting is
+   *                     compiled out if false
+   * @tparam IsTiered    Compile hot loops to native code; the counting of
+   *                     back edges is compiled out if false
+   * @param [in,out] heap    Pointer to heap memory
+   * @param [out]    counts  Execution counts of the instructions, which must
+   *                         be zero-filled; unused if IsProfiled is false
    */
+  template<bool IsProfiled, bool IsTiered, typename CellT>
   void
-  executeIR(unsigned char* heap) const BRAINFUCK_NOEXCEPT
+  executeIR(CellT* heap, std::uint64_t* counts) BRAINFUCK_NOEXCEPT
   {
     std::size_t hp = 0;
-    prefetch<0, 3>(&ircode[0], sizeof(BfInst) * ircode.size());
+    // ircode is empty if the whole program is evaluated at compile time
+    if (!ircode.empty()) {
+      prefetch<0, 3>(&ircode[0], sizeof(BfInst) * ircode.size());
+    }
     for (std::vector<BfInst>::size_type pc = 0, size = ircode.size(); pc < size; pc++) {
+      if (IsProfiled) {
+        counts[pc]++;
+      }
       switch (ircode[pc].type) {
         case BfInst::Type::kMovePointer:
           hp = hp + static_cast<std::size_t>(ircode[pc].op1);
           break;
         case BfInst::Type::kAdd:
-          heap[hp] = static_cast<unsigned char>(heap[hp] + ircode[pc].op1);
+          heap[hp + static_cast<std::size_t>(ircode[pc].op2)] = static_cast<CellT>(heap[hp + static_cast<std::size_t>(ircode[pc].op2)] + static_cast<CellT>(ircode[pc].op1));
           break;
         case BfInst::Type::kPutchar:
-          std::cout.put(static_cast<char>(heap[hp]));
+          outputSink->put(static_cast<unsigned char>(heap[hp + static_cast<std::size_t>(ircode[pc].op1)]));
           break;
         case BfInst::Type::kGetchar:
-          std::cout.flush();
-          heap[hp] = static_cast<unsigned char>(std::cin.get());
+          heap[hp + static_cast<std::size_t>(ircode[pc].op1)] = static_cast<CellT>(static_cast<unsigned char>(readInput()));
           break;
         case BfInst::Type::kLoopStart:
-          if (BRAINFUCK_LIKELY(heap[hp] == 0)) {
+          if (IsTiered && nativeLoops->get(pc) != NULL) {
+            hp = executeNativeLoop(heap, hp, pc);
+            pc = static_cast<std::size_t>(ircode[pc].op1);
+          } else if (BRAINFUCK_LIKELY(heap[hp] == 0)) {
             pc = static_cast<std::size_t>(ircode[pc].op1);
           }
           break;
         case BfInst::Type::kLoopEnd:
           if (BRAINFUCK_LIKELY(heap[hp] != 0)) {
-            pc = static_cast<std::size_t>(ircode[pc].op1);
+            if (IsTiered && BRAINFUCK_UNLIKELY(nativeLoops->countBackEdge(pc))) {
+              compileHotLoop(static_cast<std::size_t>(ircode[pc].op1), pc);
+              hp = executeNativeLoop(heap, hp, static_cast<std::size_t>(ircode[pc].op1));
+            } else {
+              pc = static_cast<std::size_t>(ircode[pc].op1);
+            }
           }
           break;
         case BfInst::Type::kIf:
@@ -998,24 +4681,58 @@ public:
           // Do nothing
           break;
         case BfInst::Type::kAssign:
-          heap[hp] = static_cast<unsigned char>(ircode[pc].op1);
+          heap[hp + static_cast<std::size_t>(ircode[pc].op2)] = static_cast<CellT>(ircode[pc].op1);
           break;
         case BfInst::Type::kSearchZero:
-          {
-            std::size_t offset = static_cast<std::size_t>(ircode[pc].op1);
-            while (heap[hp]) {
-              hp += offset;
-            }
-          }
+          hp = static_cast<std::size_t>(searchZero(heap + hp, ircode[pc].op1) - heap);
           break;
         case BfInst::Type::kAddVar:
-          heap[hp + static_cast<std::size_t>(ircode[pc].op1)] = static_cast<unsigned char>(heap[hp + static_cast<std::size_t>(ircode[pc].op1)] + heap[hp]);
+          heap[hp + static_cast<std::size_t>(ircode[pc].op1)] = static_cast<CellT>(heap[hp + static_cast<std::size_t>(ircode[pc].op1)] + heap[hp]);
           break;
         case BfInst::Type::kSubVar:
-          heap[hp + static_cast<std::size_t>(ircode[pc].op1)] = static_cast<unsigned char>(heap[hp + static_cast<std::size_t>(ircode[pc].op1)] - heap[hp]);
+          heap[hp + static_cast<std::size_t>(ircode[pc].op1)] = static_cast<CellT>(heap[hp + static_cast<std::size_t>(ircode[pc].op1)] - heap[hp]);
           break;
         case BfInst::Type::kAddCMulVar:
-          heap[hp + static_cast<std::size_t>(ircode[pc].op1)] = static_cast<unsigned char>(heap[hp + static_cast<std::size_t>(ircode[pc].op1)] + heap[hp] * ircode[pc].op2);
+          heap[hp + static_cast<std::size_t>(ircode[pc].op1)] = mulAddCell(heap[hp + static_cast<std::size_t>(ircode[pc].op1)], heap[hp], ircode[pc].op2);
+          break;
+        case BfInst::Type::kAddVarFrom:
+          heap[hp + static_cast<std::size_t>(ircode[pc].op1)] = static_cast<CellT>(heap[hp + static_cast<std::size_t>(ircode[pc].op1)] + heap[hp + static_cast<std::size_t>(ircode[pc].op2)]);
+          break;
+        case BfInst::Type::kSubVarFrom:
+          heap[hp + static_cast<std::size_t>(ircode[pc].op1)] = static_cast<CellT>(heap[hp + static_cast<std::size_t>(ircode[pc].op1)] - heap[hp + static_cast<std::size_t>(ircode[pc].op2)]);
+          break;
+        case BfInst::Type::kMovePointerAdd:
+          hp = hp + static_cast<std::size_t>(ircode[pc].op1);
+          heap[hp] = static_cast<CellT>(heap[hp] + static_cast<CellT>(ircode[pc].op2));
+          break;
+        case BfInst::Type::kAddMovePointer:
+          heap[hp] = static_cast<CellT>(heap[hp] + static_cast<CellT>(ircode[pc].op1));
+          hp = hp + static_cast<std::size_t>(ircode[pc].op2);
+          break;
+        case BfInst::Type::kMovePointerAssign:
+          hp = hp + static_cast<std::size_t>(ircode[pc].op1);
+          heap[hp] = static_cast<CellT>(ircode[pc].op2);
+          break;
+        case BfInst::Type::kAssignMovePointer:
+          heap[hp] = static_cast<CellT>(ircode[pc].op1);
+          hp = hp + static_cast<std::size_t>(ircode[pc].op2);
+          break;
+        case BfInst::Type::kMovePointerIf:
+          hp = hp + static_cast<std::size_t>(ircode[pc].op2);
+          if (heap[hp] == 0) {
+            pc = static_cast<std::size_t>(ircode[pc].op1);
+          }
+          break;
+        case BfInst::Type::kMovePointerLoopEnd:
+          hp = hp + static_cast<std::size_t>(ircode[pc].op2);
+          if (BRAINFUCK_LIKELY(heap[hp] != 0)) {
+            if (IsTiered && BRAINFUCK_UNLIKELY(nativeLoops->countBackEdge(pc))) {
+              compileHotLoop(static_cast<std::size_t>(ircode[pc].op1), pc);
+              hp = executeNativeLoop(heap, hp, static_cast<std::size_t>(ircode[pc].op1));
+            } else {
+              pc = static_cast<std::size_t>(ircode[pc].op1);
+            }
+          }
           break;
         case BfInst::Type::kInfLoop:
           if (heap[hp]) {
@@ -1023,37 +4740,364 @@ public:
           }
           break;
         case BfInst::Type::kBreakPoint:
-#if defined(_MSC_VER)
-          __debugbreak();
-#elif defined(__i386__) || defined(__x86_64__)
-          __asm__ volatile("int $0x03");
-#elif defined(__thumb__)
-          __asm__ volatile(".inst 0xde01");
-#elif defined(__arm__) && !defined(__thumb__)
-          __asm__ volatile(".inst 0xe7f001f0");
-#elif defined(__aarch64__) && defined(__APPLE__)
-          __builtin_trap();
-#elif defined(__aarch64__)
-          __asm__ volatile(".inst 0xd4200000");
-#elif defined(_WIN32)
-          __builtin_trap();
-#else
-          std::raise(SIGTRAP);
-#endif  // defined(MSC_VER)
+          debugBreak();
         case BfInst::Type::kUnknown:
           break;
       }
     }
-    std::cout.put('\n');
-    std::cout.flush();
+    outputSink->put('\n');
+    outputSink->flush();
+  }
+
+  /*!
+   * @brief Compile a hot loop to native code in tiered execution
+   * @param [in] begin  Index of kLoopStart of the loop
+   * @param [in] last   Index of the instruction which closes the loop
+   */
+  void
+  compileHotLoop(std::size_t begin, std::size_t last) BRAINFUCK_NOEXCEPT
+  {
+    compileToNative(begin, last + 1, true);
+    nativeLoops->add(begin, cg.release());
+  }
+
+  /*!
+   * @brief Execute the native code of a loop in tiered execution
+   * @param [in,out] heap  Pointer to heap memory
+   * @param [in]     hp    Index of the current cell
+   * @param [in]     pc    Index of kLoopStart of the loop
+   * @return Index of the current cell after the loop
+   */
+  template<typename CellT>
+  std::size_t
+  executeNativeLoop(CellT* heap, std::size_t hp, std::size_t pc) const BRAINFUCK_NOEXCEPT
+  {
+    CellT* p = static_cast<CellT*>(nativeLoops->get(pc)(writeJitOutput, readJitInput, heap + hp, outputSink));
+    return static_cast<std::size_t>(p - heap);
+  }
+
+  /*!
+   * @brief Execute IR code with threaded code
+   *
+   * IR code is translated into an array of handler addresses and resolved
+   * jump destinations before execution.
+   * If labels as values are not available, the translated code is dispatched
+   * with a switch statement.
+   * @param [in,out] heap  Pointer to heap memory
+   */
+#if defined(BRAINFUCK_COMPUTED_GOTO_AVAILABLE) && (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ >= 8 || defined(__clang__))
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wpedantic"
+#endif  // defined(BRAINFUCK_COMPUTED_GOTO_AVAILABLE) && (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ >= 8 || defined(__clang__))
+  template<typename CellT>
+  void
+  executeIRThreaded(CellT* heap) BRAINFUCK_NOEXCEPT
+  {
+#ifdef BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+    // Same order as BfInst::Type
+    static const void* const kHandlers[] = {
+      &&L_kMovePointer, &&L_kAdd,
+      &&L_kPutchar, &&L_kGetchar,
+      &&L_kLoopStart, &&L_kLoopEnd, &&L_kIf, &&L_kEndIf,
+      &&L_kAssign, &&L_kSearchZero,
+      &&L_kAddVar, &&L_kSubVar, &&L_kAddCMulVar,
+      &&L_kAddVarFrom, &&L_kSubVarFrom,
+      &&L_kMovePointerAdd, &&L_kAddMovePointer, &&L_kMovePointerAssign, &&L_kAssignMovePointer,
+      &&L_kMovePointerIf, &&L_kMovePointerLoopEnd,
+      &&L_kInfLoop,
+      &&L_kBreakPoint,
+      &&L_kUnknown
+    };
+#  define BRAINFUCK_THREADED_CASE(type)  L_##type
+#  define BRAINFUCK_THREADED_NEXT()  goto *(++ip)->label
+#  define BRAINFUCK_THREADED_JUMP()  goto *(ip = ip->jump)->label
+#else
+#  define BRAINFUCK_THREADED_CASE(type)  case BfInst::Type::type
+#  define BRAINFUCK_THREADED_NEXT()  ip++; continue
+#  define BRAINFUCK_THREADED_JUMP()  ip = ip->jump; continue
+#endif  // BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+
+    std::vector<ThreadedInst>& tcode = threadedCode;
+    tcode.assign(ircode.size() + 1, ThreadedInst());
+    for (std::vector<BfInst>::size_type pc = 0, size = ircode.size(); pc < size; pc++) {
+      const BfInst& inst = ircode[pc];
+      ThreadedInst& tinst = tcode[pc];
+#ifdef BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+      tinst.label = kHandlers[static_cast<std::size_t>(inst.type)];
+#else
+      tinst.type = inst.type;
+#endif  // BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+      tinst.op1 = inst.op1;
+      tinst.op2 = inst.op2;
+      if (isJumpInstruction(inst.type)) {
+        tinst.jump = &tcode[static_cast<std::size_t>(inst.op1) + 1];
+      }
+    }
+    // Terminator
+#ifdef BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+    tcode.back().label = &&L_kUnknown;
+#else
+    tcode.back().type = BfInst::Type::kUnknown;
+#endif  // BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+
+    CellT* p = heap;
+    const ThreadedInst* ip = &tcode[0];
+    prefetch<0, 3>(ip, sizeof(ThreadedInst) * tcode.size());
+#ifdef BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+    goto *ip->label;
+#else
+    for (;;) {
+      switch (ip->type) {
+#endif  // BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+        BRAINFUCK_THREADED_CASE(kMovePointer):
+          p += ip->op1;
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kAdd):
+          p[ip->op2] = static_cast<CellT>(p[ip->op2] + static_cast<CellT>(ip->op1));
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kPutchar):
+          outputSink->put(static_cast<unsigned char>(p[ip->op1]));
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kGetchar):
+          p[ip->op1] = static_cast<CellT>(static_cast<unsigned char>(readInput()));
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kLoopStart):
+        BRAINFUCK_THREADED_CASE(kIf):
+          if (*p == 0) {
+            BRAINFUCK_THREADED_JUMP();
+          }
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kLoopEnd):
+          if (BRAINFUCK_LIKELY(*p != 0)) {
+            BRAINFUCK_THREADED_JUMP();
+          }
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kEndIf):
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kAssign):
+          p[ip->op2] = static_cast<CellT>(ip->op1);
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kSearchZero):
+          p = searchZero(p, ip->op1);
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kAddVar):
+          p[ip->op1] = static_cast<CellT>(p[ip->op1] + *p);
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kSubVar):
+          p[ip->op1] = static_cast<CellT>(p[ip->op1] - *p);
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kAddCMulVar):
+          p[ip->op1] = mulAddCell(p[ip->op1], *p, ip->op2);
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kAddVarFrom):
+          p[ip->op1] = static_cast<CellT>(p[ip->op1] + p[ip->op2]);
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kSubVarFrom):
+          p[ip->op1] = static_cast<CellT>(p[ip->op1] - p[ip->op2]);
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kMovePointerAdd):
+          p += ip->op1;
+          *p = static_cast<CellT>(*p + static_cast<CellT>(ip->op2));
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kAddMovePointer):
+          *p = static_cast<CellT>(*p + static_cast<CellT>(ip->op1));
+          p += ip->op2;
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kMovePointerAssign):
+          p += ip->op1;
+          *p = static_cast<CellT>(ip->op2);
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kAssignMovePointer):
+          *p = static_cast<CellT>(ip->op1);
+          p += ip->op2;
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kMovePointerIf):
+          p += ip->op2;
+          if (*p == 0) {
+            BRAINFUCK_THREADED_JUMP();
+          }
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kMovePointerLoopEnd):
+          p += ip->op2;
+          if (BRAINFUCK_LIKELY(*p != 0)) {
+            BRAINFUCK_THREADED_JUMP();
+          }
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kInfLoop):
+          if (*p) {
+            for (;;);
+          }
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kBreakPoint):
+          debugBreak();
+          BRAINFUCK_THREADED_NEXT();
+        BRAINFUCK_THREADED_CASE(kUnknown):
+#ifndef BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+          break;
+      }
+      break;
+    }
+#endif  // BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+    outputSink->put('\n');
+    outputSink->flush();
+#undef BRAINFUCK_THREADED_CASE
+#undef BRAINFUCK_THREADED_NEXT
+#undef BRAINFUCK_THREADED_JUMP
+  }
+#if defined(BRAINFUCK_COMPUTED_GOTO_AVAILABLE) && (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ >= 8 || defined(__clang__))
+#  pragma GCC diagnostic pop
+#endif  // defined(BRAINFUCK_COMPUTED_GOTO_AVAILABLE) && (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ >= 8 || defined(__clang__))
+
+  /*!
+   * @brief Execute packed IR code
+   * @param [in,out] heap  Pointer to heap memory
+   */
+  template<typename CellT>
+  void
+  executePackedIR(CellT* heap) const BRAINFUCK_NOEXCEPT
+  {
+#define BRAINFUCK_PACKED_OPCODE(type, width) \
+  (static_cast<int>(BfInst::Type::type) | ((width) << kPackedTypeBits))
+#define BRAINFUCK_PACKED_CASE(type, width, T, stmt) \
+        case BRAINFUCK_PACKED_OPCODE(type, width): \
+          { \
+            const int op1 = fetchPackedOperand<T>(ip); \
+            stmt; \
+          } \
+          continue
+#define BRAINFUCK_PACKED_CASES(type, stmt) \
+        BRAINFUCK_PACKED_CASE(type, kPackedWidth8, i8, stmt); \
+        BRAINFUCK_PACKED_CASE(type, kPackedWidth16, i16, stmt); \
+        BRAINFUCK_PACKED_CASE(type, kPackedWidth32, i32, stmt)
+#define BRAINFUCK_PACKED_CASE2(type, width, T, stmt) \
+        case BRAINFUCK_PACKED_OPCODE(type, width): \
+          { \
+            const int op1 = fetchPackedOperand<T>(ip); \
+            const int op2 = fetchPackedOperand<T>(ip); \
+            stmt; \
+          } \
+          continue
+#define BRAINFUCK_PACKED_CASES2(type, stmt) \
+        BRAINFUCK_PACKED_CASE2(type, kPackedWidth8, i8, stmt); \
+        BRAINFUCK_PACKED_CASE2(type, kPackedWidth16, i16, stmt); \
+        BRAINFUCK_PACKED_CASE2(type, kPackedWidth32, i32, stmt)
+
+    CellT* p = heap;
+    const unsigned char* ip = &packedIRCode[0];
+    prefetch<0, 3>(ip, packedIRCode.size());
+    for (;;) {
+      switch (*ip++) {
+        BRAINFUCK_PACKED_CASES(kMovePointer, p += op1);
+        BRAINFUCK_PACKED_CASES2(kAdd, p[op2] = static_cast<CellT>(p[op2] + static_cast<CellT>(op1)));
+        BRAINFUCK_PACKED_CASES(kPutchar, outputSink->put(static_cast<unsigned char>(p[op1])));
+        BRAINFUCK_PACKED_CASES(kGetchar, p[op1] = static_cast<CellT>(static_cast<unsigned char>(readInput())));
+        BRAINFUCK_PACKED_CASES(kLoopStart, if (*p == 0) ip += op1);
+        BRAINFUCK_PACKED_CASES(kLoopEnd, if (BRAINFUCK_LIKELY(*p != 0)) ip += op1);
+        BRAINFUCK_PACKED_CASES(kIf, if (*p == 0) ip += op1);
+        BRAINFUCK_PACKED_CASES2(kAssign, p[op2] = static_cast<CellT>(op1));
+        BRAINFUCK_PACKED_CASES(kSearchZero, p = searchZero(p, op1));
+        BRAINFUCK_PACKED_CASES(kAddVar, p[op1] = static_cast<CellT>(p[op1] + *p));
+        BRAINFUCK_PACKED_CASES(kSubVar, p[op1] = static_cast<CellT>(p[op1] - *p));
+        BRAINFUCK_PACKED_CASES2(kAddCMulVar, p[op1] = mulAddCell(p[op1], *p, op2));
+        BRAINFUCK_PACKED_CASES2(kAddVarFrom, p[op1] = static_cast<CellT>(p[op1] + p[op2]));
+        BRAINFUCK_PACKED_CASES2(kSubVarFrom, p[op1] = static_cast<CellT>(p[op1] - p[op2]));
+        BRAINFUCK_PACKED_CASES2(kMovePointerAdd, p += op1; *p = static_cast<CellT>(*p + static_cast<CellT>(op2)));
+        BRAINFUCK_PACKED_CASES2(kAddMovePointer, *p = static_cast<CellT>(*p + static_cast<CellT>(op1)); p += op2);
+        BRAINFUCK_PACKED_CASES2(kMovePointerAssign, p += op1; *p = static_cast<CellT>(op2));
+        BRAINFUCK_PACKED_CASES2(kAssignMovePointer, *p = static_cast<CellT>(op1); p += op2);
+        BRAINFUCK_PACKED_CASES2(kMovePointerIf, p += op2; if (*p == 0) ip += op1);
+        BRAINFUCK_PACKED_CASES2(kMovePointerLoopEnd, p += op2; if (BRAINFUCK_LIKELY(*p != 0)) ip += op1);
+        case BRAINFUCK_PACKED_OPCODE(kInfLoop, kPackedWidth8):
+          if (*p) {
+            for (;;);
+          }
+          continue;
+        case BRAINFUCK_PACKED_OPCODE(kBreakPoint, kPackedWidth8):
+          debugBreak();
+          continue;
+        default:
+          break;
+      }
+      break;
+    }
+    outputSink->put('\n');
+    outputSink->flush();
+#undef BRAINFUCK_PACKED_OPCODE
+#undef BRAINFUCK_PACKED_CASE
+#undef BRAINFUCK_PACKED_CASES
+#undef BRAINFUCK_PACKED_CASE2
+#undef BRAINFUCK_PACKED_CASES2
+  }
+
+  /*!
+   * @brief Write the output of the prefix executed at compile time
+   */
+  void
+  writePrefixOutput() const BRAINFUCK_NOEXCEPT
+  {
+    outputSink->write(prefixOutput.data(), prefixOutput.size());
+  }
+
+  /*!
+   * @brief Get the key of the native code in the on-disk cache
+   *
+   * The key consists of everything which the native code depends on: the
+   * version, the architecture, the CPU features used by the code, the
+   * settings and the source code.
+   * @param [in] hasTopBreakPoint  Whether a break point is at the top of code
+   * @return The key
+   */
+  std::string
+  getJitCacheKey(bool hasTopBreakPoint) const
+  {
+    std::ostringstream oss;
+    oss << "version: " << jitCacheVersion << "\n"
+#ifdef XBYAK32
+        << "arch: x86\n"
+#elif defined(XBYAK64_WIN)
+        << "arch: x64-win\n"
+#else
+        << "arch: x64\n"
+#endif  // XBYAK32
+        << "block width: " << getNativeBlockWidth() << "\n"
+        << "cell bits: " << cellBits << "\n"
+        << "flush: " << static_cast<int>(outputSink->getFlushPolicy()) << " " << outputSink->getFlushBytes() << "\n"
+        << "eval limit: " << evalStepLimit << " " << evalMemoryLimit << "\n"
+        << "top break point: " << hasTopBreakPoint << "\n";
+    if (isIRLoaded) {
+      oss << "ir: " << IRFile::serialize(ircode, prefixOutput, cellBits);
+    } else {
+      oss << "source: " << bfSource;
+    }
+    return oss.str();
+  }
+
+  /*!
+   * @brief Get the native code
+   * @return The code mapped from the on-disk cache, or the compiled code
+   */
+  const Xbyak::uint8*
+  getNativeCode() const BRAINFUCK_NOEXCEPT
+  {
+    return cachedCode.get() != NULL ? cachedCode->getCode() : cg->getCode();
+  }
+
+  /*!
+   * @brief Get the size of the native code
+   * @return Size of the native code
+   */
+  std::size_t
+  getNativeCodeSize() const BRAINFUCK_NOEXCEPT
+  {
+    return cachedCode.get() != NULL ? cachedCode->getCodeSize() : cg->getSize();
   }
 
   void
-  executeJit(unsigned char* heap) const BRAINFUCK_NOEXCEPT
+  executeJit(void* heap) const BRAINFUCK_NOEXCEPT
   {
-    cg.getCode<void (*)(int (*)(int), int (*)(), unsigned char*)>()
-      (std::putchar, getcharWithFlush, heap);
-    std::fflush(stdout);
+    reinterpret_cast<void (*)(void (*)(const unsigned char*, std::size_t, OutputSink*), int (*)(const unsigned char*, std::size_t, OutputSink*), void*, OutputSink*)>(
+        const_cast<Xbyak::uint8*>(getNativeCode()))(writeJitOutput, readJitInput, heap, outputSink);
+    outputSink->flush();
   }
 
   /*!
@@ -1068,13 +5112,13 @@ public:
           std::cout << "kMovePointer: " << ircode[pc].op1 << std::endl;
           break;
         case BfInst::Type::kAdd:
-          std::cout << "kAdd: " << ircode[pc].op1 << std::endl;
+          std::cout << "kAdd: " << ircode[pc].op1 << ", " << ircode[pc].op2 << std::endl;
           break;
         case BfInst::Type::kPutchar:
-          std::cout << "kPutchar" << std::endl;
+          std::cout << "kPutchar: " << ircode[pc].op1 << std::endl;
           break;
         case BfInst::Type::kGetchar:
-          std::cout << "kGetchar" << std::endl;
+          std::cout << "kGetchar: " << ircode[pc].op1 << std::endl;
           break;
         case BfInst::Type::kLoopStart:
           std::cout << "kLoopStart: " << ircode[pc].op1 << std::endl;
@@ -1089,7 +5133,7 @@ public:
           std::cout << "kEndIf" << std::endl;
           break;
         case BfInst::Type::kAssign:
-          std::cout << "kAssign: " << ircode[pc].op1 << std::endl;
+          std::cout << "kAssign: " << ircode[pc].op1 << ", " << ircode[pc].op2 << std::endl;
           break;
         case BfInst::Type::kSearchZero:
           std::cout << "kSearchZero: " << ircode[pc].op1 << std::endl;
@@ -1103,6 +5147,30 @@ public:
         case BfInst::Type::kAddCMulVar:
           std::cout << "kAddCMulVar: " << ircode[pc].op1 << ", " << ircode[pc].op2 << std::endl;
           break;
+        case BfInst::Type::kAddVarFrom:
+          std::cout << "kAddVarFrom: " << ircode[pc].op1 << ", " << ircode[pc].op2 << std::endl;
+          break;
+        case BfInst::Type::kSubVarFrom:
+          std::cout << "kSubVarFrom: " << ircode[pc].op1 << ", " << ircode[pc].op2 << std::endl;
+          break;
+        case BfInst::Type::kMovePointerAdd:
+          std::cout << "kMovePointerAdd: " << ircode[pc].op1 << ", " << ircode[pc].op2 << std::endl;
+          break;
+        case BfInst::Type::kAddMovePointer:
+          std::cout << "kAddMovePointer: " << ircode[pc].op1 << ", " << ircode[pc].op2 << std::endl;
+          break;
+        case BfInst::Type::kMovePointerAssign:
+          std::cout << "kMovePointerAssign: " << ircode[pc].op1 << ", " << ircode[pc].op2 << std::endl;
+          break;
+        case BfInst::Type::kAssignMovePointer:
+          std::cout << "kAssignMovePointer: " << ircode[pc].op1 << ", " << ircode[pc].op2 << std::endl;
+          break;
+        case BfInst::Type::kMovePointerIf:
+          std::cout << "kMovePointerIf: " << ircode[pc].op1 << ", " << ircode[pc].op2 << std::endl;
+          break;
+        case BfInst::Type::kMovePointerLoopEnd:
+          std::cout << "kMovePointerLoopEnd: " << ircode[pc].op1 << ", " << ircode[pc].op2 << std::endl;
+          break;
         case BfInst::Type::kInfLoop:
           std::cout << "kInfLoop" << std::endl;
           break;
@@ -1116,30 +5184,125 @@ public:
     }
   }
 
+  /*!
+   * @brief Dump byte size of IR code and packed IR code
+   */
+  void
+  dumpIRSize() const BRAINFUCK_NOEXCEPT
+  {
+    std::size_t irSize = sizeof(BfInst) * ircode.size();
+    std::cout << "Number of IR instructions: " << ircode.size() << "\n"
+              << "IR code size:              " << irSize << " bytes\n"
+              << "Packed IR code size:       " << packedIRCode.size() << " bytes";
+    if (irSize > 0) {
+      std::cout << " (" << std::fixed << std::setprecision(2)
+                << 100.0 * static_cast<double>(packedIRCode.size()) / static_cast<double>(irSize)
+                << "%)";
+    }
+    std::cout << std::endl;
+  }
+
+  /*!
+   * @brief Dump hot spots of the last execution with setProfile(true)
+   *
+   * IR instructions are ranked by execution count, and loops which remain in
+   * IR code are ranked by the number of iterations.
+   * Each entry is shown with the optimization which produced it and the part
+   * of the source code it comes from.
+   * Loops reduced to kAssign, kSearchZero, kAddCMulVar and so on are listed as
+   * instructions.
+   * @param [in,out] os  Output stream
+   */
+  void
+  dumpProfile(std::ostream& os) const
+  {
+    std::uint64_t total = 0;
+    std::vector<std::size_t> executed;
+    std::vector<std::size_t> loops;
+    for (std::vector<std::uint64_t>::size_type pc = 0, size = profileCounts.size(); pc < size; pc++) {
+      if (profileCounts[pc] == 0) {
+        continue;
+      }
+      total += profileCounts[pc];
+      executed.push_back(pc);
+      if (ircode[pc].type == BfInst::Type::kLoopEnd || ircode[pc].type == BfInst::Type::kMovePointerLoopEnd) {
+        loops.push_back(pc);
+      }
+    }
+    std::stable_sort(executed.begin(), executed.end(), ProfileCountGreater(profileCounts));
+    std::stable_sort(loops.begin(), loops.end(), ProfileCountGreater(profileCounts));
+
+    std::ios::fmtflags flags = os.flags();
+    os << "Executed IR instructions: " << total << "\n"
+       << "\nHot instructions:\n";
+    for (std::vector<std::size_t>::size_type i = 0; i < executed.size() && i < kProfileReportSize; i++) {
+      std::size_t pc = executed[i];
+      os << std::setw(4) << i + 1 << ". " << std::setw(12) << profileCounts[pc]
+         << " (" << std::fixed << std::setprecision(2) << std::setw(6)
+         << 100.0 * static_cast<double>(profileCounts[pc]) / static_cast<double>(total) << "%) "
+         << "#" << pc << " " << getInstructionName(ircode[pc].type);
+      if (pc < sourceRanges.size()) {
+        if (sourceRanges[pc].origin != NULL) {
+          os << " from " << sourceRanges[pc].origin;
+        }
+        dumpSourceRange(os, sourceRanges[pc].begin, sourceRanges[pc].end);
+      }
+      os << "\n";
+    }
+    os << "\nHot loops:\n";
+    for (std::vector<std::size_t>::size_type i = 0; i < loops.size() && i < kProfileReportSize; i++) {
+      std::size_t pc = loops[i];
+      std::size_t opener = static_cast<std::size_t>(ircode[pc].op1);
+      os << std::setw(4) << i + 1 << ". " << std::setw(12) << profileCounts[pc] << " iterations, "
+         << profileCounts[opener] << " entries, #" << opener << "-#" << pc;
+      if (pc < sourceRanges.size()) {
+        dumpSourceRange(os, sourceRanges[opener].begin, sourceRanges[pc].end);
+      }
+      os << "\n";
+    }
+    os.flags(flags);
+    os.flush();
+  }
+
   void
   emit(std::ostream& os, Target target) BRAINFUCK_NOEXCEPT
   {
     switch (target) {
       case Target::kC:
-        GeneratorC(os).emit(ircode);
+        {
+          GeneratorC gen(os);
+          gen.setBidirectionalTape(isBidirectionalTape);
+          gen.setCellBits(cellBits);
+          gen.emit(ircode, prefixOutput);
+        }
         break;
       case Target::kXbyakC:
         dumpXbyak(os);
         break;
       case Target::kWinX86:
-        GeneratorWinX86(os).emit(ircode);
+        GeneratorWinX86(os).emit(ircode, prefixOutput);
         break;
       case Target::kWinX64:
-        GeneratorWinX64(os).emit(ircode);
+        GeneratorWinX64(os).emit(ircode, prefixOutput);
         break;
       case Target::kElfX86:
-        GeneratorElfX86(os).emit(ircode);
+        {
+          GeneratorElfX86 gen(os);
+          gen.setBidirectionalTape(isBidirectionalTape);
+          gen.setCellBits(cellBits);
+          gen.emit(ircode, prefixOutput);
+        }
         break;
       case Target::kElfX64:
-        GeneratorElfX64(os).emit(ircode);
+        {
+          GeneratorElfX64 gen(os);
+          gen.setBidirectionalTape(isBidirectionalTape);
+          gen.setCellBits(cellBits);
+          gen.emit(ircode, prefixOutput);
+        }
         break;
       case Target::kElfArmeabi:
-        GeneratorElfArmeabi(os).emit(ircode);
+        GeneratorElfArmeabi(os).emit(ircode, prefixOutput);
         break;
       default:
         assert(false);
@@ -1149,12 +5312,11 @@ public:
   void
   dumpXbyak(std::ostream& os)
   {
-    std::size_t size = cg.getSize();
-    if (size == 0) {
+    if (state != CompileType::kJit) {
       compile(CompileType::kJit);
-      size = cg.getSize();
     }
-    const Xbyak::uint8* code = cg.getCode();
+    std::size_t size = getNativeCodeSize();
+    const Xbyak::uint8* code = getNativeCode();
 
     os << "#include <stdio.h>\n"
           "#include <stdlib.h>\n"
@@ -1190,8 +5352,21 @@ public:
           "#  pragma GCC diagnostic ignored \"-Wpedantic\"\n"
 #endif  // defined(_WIN32) || defined(_WIN64) || (defined(__CYGWIN__) && defined(__x86_64__))
           "#endif\n\n"
-          "static unsigned char stack[65536];\n"
-          "/* code size: " << size << " bytes */\n"
+       << "static unsigned char stack[65536 * " << cellBits / 8 << (isBidirectionalTape ? " * 2];\n" : "];\n");
+    if (!prefixOutput.empty()) {
+      os << "/* output of the prefix executed at compile time: " << prefixOutput.size() << " bytes */\n"
+            "static const unsigned char prefix_output[] = {\n"
+         << std::hex << " ";
+      for (std::string::size_type i = 0; i < prefixOutput.size(); i++) {
+        os << " 0x" << std::setfill('0') << std::setw(2) << static_cast<unsigned int>(static_cast<unsigned char>(prefixOutput[i])) << ",";
+        if (BRAINFUCK_UNLIKELY(i % 16 == 15)) {
+          os << "\n ";
+        }
+      }
+      os << std::dec
+         << "\n};\n";
+    }
+    os << "/* code size: " << size << " bytes */\n"
           "static const unsigned char code[] = {\n"
        << std::hex << " ";
     for (std::size_t i = 0; i < size; i++) {
@@ -1202,17 +5377,34 @@ public:
     }
     os << std::dec
        << "\n};\n\n\n"
+          "static void\n"
+          "write_output(const unsigned char *buffer, size_t size, void *sink)\n"
+          "{\n"
+          "  (void) sink;\n"
+          "  fwrite(buffer, 1, size, stdout);\n"
+          "  fflush(stdout);\n"
+          "}\n\n\n"
+          "static int\n"
+          "read_input(const unsigned char *buffer, size_t size, void *sink)\n"
+          "{\n"
+          "  write_output(buffer, size, sink);\n"
+          "  return getchar();\n"
+          "}\n\n\n"
           "int\n"
           "main(void)\n"
-          "{\n"
+          "{\n";
 #if defined(_WIN32) || defined(_WIN64) || (defined(__CYGWIN__) && defined(__x86_64__))
-          "  DWORD old_protect;\n"
-          "  VirtualProtect((LPVOID) code, sizeof(code), PAGE_EXECUTE_READWRITE, &old_protect);\n"
+    os << "  DWORD old_protect;\n"
+          "  VirtualProtect((LPVOID) code, sizeof(code), PAGE_EXECUTE_READWRITE, &old_protect);\n";
 #elif defined(__linux__)
-          "  unsigned long page_size = (unsigned long) (sysconf(_SC_PAGESIZE) - 1);\n"
-          "  mprotect((void *) code, (sizeof(code) + page_size) & ~page_size, PROT_READ | PROT_EXEC);\n"
+    os << "  unsigned long page_size = (unsigned long) (sysconf(_SC_PAGESIZE) - 1);\n"
+          "  mprotect((void *) code, (sizeof(code) + page_size) & ~page_size, PROT_READ | PROT_EXEC);\n";
 #endif  // defined(_WIN32) || defined(_WIN64) || (defined(__CYGWIN__) && defined(__x86_64__))
-          "  ((void (*)(int (*)(int), int (*)(), unsigned char *)) (unsigned char *) code)(putchar, getchar, stack);\n"
+    if (!prefixOutput.empty()) {
+      os << "  fwrite(prefix_output, 1, sizeof(prefix_output), stdout);\n";
+    }
+    os << "  ((void (*)(void (*)(const unsigned char *, size_t, void *), int (*)(const unsigned char *, size_t, void *), unsigned char *, void *)) (unsigned char *) code)(write_output, read_input, "
+       << (isBidirectionalTape ? "stack + sizeof(stack) / 2" : "stack") << ", NULL);\n"
           "  return EXIT_SUCCESS;\n"
           "}\n\n\n"
 #if defined(_WIN32) || defined(_WIN64) || (defined(__CYGWIN__) && defined(__x86_64__))
@@ -1277,5 +5469,8 @@ public:
 #ifdef BRAINFUCK_EMPLACE_AVAILABLE
 #  undef BRAINFUCK_EMPLACE_AVAILABLE
 #endif  // BRAINFUCK_EMPLACE_AVAILABLE
+#ifdef BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+#  undef BRAINFUCK_COMPUTED_GOTO_AVAILABLE
+#endif  // BRAINFUCK_COMPUTED_GOTO_AVAILABLE
 
 #endif  // BRAINFUCK_HPP
@@ -8,6 +8,7 @@
 
 #include <cassert>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "../BfInst.h"
@@ -29,10 +30,20 @@ class CodeGenerator
 protected:
   //! Output stream pointer
   std::ostream& oStream;
+  //! Whether the pointer starts in the middle of the tape
+  bool isBidirectionalTape;
+  //! Width of a cell in bits: 8, 16, 32 or 64
+  int cellBits;
+  //! Whether IR code remains after the output of the prefix, which is known
+  //! when the header is emitted
+  bool hasCode;
 
 public:
   explicit CodeGenerator(std::ostream& oStream) CODE_GENERATOR_NOEXCEPT :
-    oStream(oStream)
+    oStream(oStream),
+    isBidirectionalTape(false),
+    cellBits(8),
+    hasCode(false)
   {}
 
 #if __cplusplus >= 201103 || (defined(_MSC_VER) && _MSC_VER >= 1800)
@@ -49,23 +60,59 @@ private:
 public:
 #endif  // __cplusplus >= 201103L && (defined(_MSC_VER) && _MSC_VER >= 1800)
 
+  /*!
+   * @brief Enable or disable the bidirectional tape
+   *
+   * With the bidirectional tape, the tape is doubled and the pointer starts
+   * in the middle of it, so that negative indices are valid.
+   * Supported by GeneratorC, GeneratorElfX86 and GeneratorElfX64.
+   * @param [in] isBidirectional  True to enable the bidirectional tape
+   */
   void
-  emit(const std::vector<BfInst>& ircode) CODE_GENERATOR_NOEXCEPT
+  setBidirectionalTape(bool isBidirectional) CODE_GENERATOR_NOEXCEPT
   {
+    isBidirectionalTape = isBidirectional;
+  }
+
+  /*!
+   * @brief Set the width of a cell
+   *
+   * Supported by GeneratorC, GeneratorElfX86 (up to 32 bits) and
+   * GeneratorElfX64; the other generators always emit 8-bit cells.
+   * @param [in] bits  Width of a cell in bits: 8, 16, 32 or 64
+   */
+  void
+  setCellBits(int bits) CODE_GENERATOR_NOEXCEPT
+  {
+    cellBits = bits;
+  }
+
+  /*!
+   * @brief Emit a program
+   * @param [in] ircode        IR code
+   * @param [in] prefixOutput  Output written before IR code is executed
+   */
+  void
+  emit(const std::vector<BfInst>& ircode, const std::string& prefixOutput=std::string()) CODE_GENERATOR_NOEXCEPT
+  {
+    hasCode = !ircode.empty();
     emitHeader();
+    if (!prefixOutput.empty()) {
+      emitPutString(prefixOutput);
+    }
     for (std::vector<BfInst>::size_type pc = 0, size = ircode.size(); pc < size; pc++) {
       switch (ircode[pc].type) {
         case BfInst::Type::kMovePointer:
           emitMovePointer(ircode[pc].op1);
           break;
         case BfInst::Type::kAdd:
-          emitAdd(ircode[pc].op1);
+          emitAddAt(ircode[pc].op1, ircode[pc].op2);
           break;
         case BfInst::Type::kPutchar:
-          emitPutchar();
+          emitPutcharAt(ircode[pc].op1);
           break;
         case BfInst::Type::kGetchar:
-          emitGetchar();
+          emitGetcharAt(ircode[pc].op1);
           break;
         case BfInst::Type::kLoopStart:
           emitLoopStart();
@@ -80,7 +127,7 @@ public:
           emitEndIf();
           break;
         case BfInst::Type::kAssign:
-          emitAssign(ircode[pc].op1);
+          emitAssignAt(ircode[pc].op1, ircode[pc].op2);
           break;
         case BfInst::Type::kSearchZero:
           emitSearchZero(ircode[pc].op1);
@@ -94,6 +141,30 @@ public:
         case BfInst::Type::kAddCMulVar:
           emitAddCMulVar(ircode[pc].op1, ircode[pc].op2);
           break;
+        case BfInst::Type::kAddVarFrom:
+          emitAddVarFrom(ircode[pc].op1, ircode[pc].op2);
+          break;
+        case BfInst::Type::kSubVarFrom:
+          emitSubVarFrom(ircode[pc].op1, ircode[pc].op2);
+          break;
+        case BfInst::Type::kMovePointerAdd:
+          emitMovePointerAdd(ircode[pc].op1, ircode[pc].op2);
+          break;
+        case BfInst::Type::kAddMovePointer:
+          emitAddMovePointer(ircode[pc].op1, ircode[pc].op2);
+          break;
+        case BfInst::Type::kMovePointerAssign:
+          emitMovePointerAssign(ircode[pc].op1, ircode[pc].op2);
+          break;
+        case BfInst::Type::kAssignMovePointer:
+          emitAssignMovePointer(ircode[pc].op1, ircode[pc].op2);
+          break;
+        case BfInst::Type::kMovePointerIf:
+          emitMovePointerIf(ircode[pc].op2);
+          break;
+        case BfInst::Type::kMovePointerLoopEnd:
+          emitMovePointerLoopEnd(ircode[pc].op2);
+          break;
         case BfInst::Type::kInfLoop:
           emitInfLoop();
           break;
@@ -199,6 +270,84 @@ private:
     static_cast<T*>(this)->emitAddCMulVarImpl(op1, op2);
   }
 
+  void
+  emitAddVarFrom(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    static_cast<T*>(this)->emitAddVarFromImpl(op1, op2);
+  }
+
+  void
+  emitSubVarFrom(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    static_cast<T*>(this)->emitSubVarFromImpl(op1, op2);
+  }
+
+  void
+  emitMovePointerAdd(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    static_cast<T*>(this)->emitMovePointerAddImpl(op1, op2);
+  }
+
+  void
+  emitAddMovePointer(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    static_cast<T*>(this)->emitAddMovePointerImpl(op1, op2);
+  }
+
+  void
+  emitMovePointerAssign(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    static_cast<T*>(this)->emitMovePointerAssignImpl(op1, op2);
+  }
+
+  void
+  emitAssignMovePointer(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    static_cast<T*>(this)->emitAssignMovePointerImpl(op1, op2);
+  }
+
+  void
+  emitMovePointerIf(int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    static_cast<T*>(this)->emitMovePointerIfImpl(op2);
+  }
+
+  void
+  emitMovePointerLoopEnd(int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    static_cast<T*>(this)->emitMovePointerLoopEndImpl(op2);
+  }
+
+  void
+  emitAddAt(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    static_cast<T*>(this)->emitAddAtImpl(op1, op2);
+  }
+
+  void
+  emitAssignAt(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    static_cast<T*>(this)->emitAssignAtImpl(op1, op2);
+  }
+
+  void
+  emitPutcharAt(int op1) CODE_GENERATOR_NOEXCEPT
+  {
+    static_cast<T*>(this)->emitPutcharAtImpl(op1);
+  }
+
+  void
+  emitGetcharAt(int op1) CODE_GENERATOR_NOEXCEPT
+  {
+    static_cast<T*>(this)->emitGetcharAtImpl(op1);
+  }
+
+  void
+  emitPutString(const std::string& str) CODE_GENERATOR_NOEXCEPT
+  {
+    static_cast<T*>(this)->emitPutStringImpl(str);
+  }
+
   void
   emitInfLoop() CODE_GENERATOR_NOEXCEPT
   {
@@ -266,6 +415,128 @@ protected:
     emitMovePointer(-op1);
   }
 
+  void
+  emitAddVarFromImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    emitMovePointer(op2);
+    emitAddVar(op1 - op2);
+    emitMovePointer(-op2);
+  }
+
+  void
+  emitSubVarFromImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    emitMovePointer(op2);
+    emitSubVar(op1 - op2);
+    emitMovePointer(-op2);
+  }
+
+  void
+  emitMovePointerAddImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    emitMovePointer(op1);
+    emitAdd(op2);
+  }
+
+  void
+  emitAddMovePointerImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    emitAdd(op1);
+    emitMovePointer(op2);
+  }
+
+  void
+  emitMovePointerAssignImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    emitMovePointer(op1);
+    emitAssign(op2);
+  }
+
+  void
+  emitAssignMovePointerImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    emitAssign(op1);
+    emitMovePointer(op2);
+  }
+
+  void
+  emitMovePointerIfImpl(int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    emitMovePointer(op2);
+    emitIf();
+  }
+
+  void
+  emitMovePointerLoopEndImpl(int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    emitMovePointer(op2);
+    emitLoopEnd();
+  }
+
+  void
+  emitAddAtImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    if (op2 == 0) {
+      emitAdd(op1);
+    } else {
+      emitMovePointer(op2);
+      emitAdd(op1);
+      emitMovePointer(-op2);
+    }
+  }
+
+  void
+  emitAssignAtImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    if (op2 == 0) {
+      emitAssign(op1);
+    } else {
+      emitMovePointer(op2);
+      emitAssign(op1);
+      emitMovePointer(-op2);
+    }
+  }
+
+  void
+  emitPutcharAtImpl(int op1) CODE_GENERATOR_NOEXCEPT
+  {
+    if (op1 == 0) {
+      emitPutchar();
+    } else {
+      emitMovePointer(op1);
+      emitPutchar();
+      emitMovePointer(-op1);
+    }
+  }
+
+  void
+  emitGetcharAtImpl(int op1) CODE_GENERATOR_NOEXCEPT
+  {
+    if (op1 == 0) {
+      emitGetchar();
+    } else {
+      emitMovePointer(op1);
+      emitGetchar();
+      emitMovePointer(-op1);
+    }
+  }
+
+  /*!
+   * @brief Emit output of a string at the beginning of the program
+   *
+   * The current cell is used as a buffer since it is zero at that point.
+   * @param [in] str  String to output
+   */
+  void
+  emitPutStringImpl(const std::string& str) CODE_GENERATOR_NOEXCEPT
+  {
+    for (std::string::size_type i = 0; i < str.size(); i++) {
+      emitAssign(static_cast<signed char>(str[i]));
+      emitPutchar();
+    }
+    emitAssign(0);
+  }
+
   void
   emitInfLoopImpl() CODE_GENERATOR_NOEXCEPT
   {
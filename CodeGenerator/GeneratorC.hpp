@@ -7,6 +7,7 @@
 #define GENERATOR_C_HPP
 
 #include <iostream>
+#include <string>
 
 #include "SourceGenerator.hpp"
 
@@ -31,7 +32,9 @@ protected:
     oStream << "#include <signal.h>\n"
                "#include <stdio.h>\n"
                "#include <stdlib.h>\n"
-               "#include <string.h>\n\n"
+               "#include <string.h>\n"
+            << (cellBits == 8 ? "" : "#include <stdint.h>\n")
+            << "\n"
                "#define MEMORY_SIZE 65536\n\n"
                "#ifdef _MSC_VER\n"
                "#  define debugbreak __debugbreak\n"
@@ -59,9 +62,13 @@ protected:
                "#endif\n\n"
                "int\n"
                "main(void)\n"
-               "{\n"
-            << indent << "unsigned char memory[MEMORY_SIZE] = {0};\n"
-            << indent << "unsigned char *p = memory;\n\n";
+               "{\n";
+    // The tape is not declared if the whole program is executed at compile
+    // time, which would leave unused variables
+    if (hasCode) {
+      oStream << indent << getCellType() << (isBidirectionalTape ? " memory[MEMORY_SIZE * 2] = {0};\n" : " memory[MEMORY_SIZE] = {0};\n")
+              << indent << getCellType() << (isBidirectionalTape ? " *p = memory + MEMORY_SIZE;\n\n" : " *p = memory;\n\n");
+    }
     indentLevel++;
   }
 
@@ -168,7 +175,7 @@ protected:
   {
     emitIndent();
     if (op1 > 0) {
-      if (op1 == 1) {
+      if (op1 == 1 && cellBits == 8) {
         oStream << "p = memchr(p, 0, sizeof(memory));\n";
       } else {
         oStream << "for (; *p; p += " << op1 << ");\n";
@@ -215,7 +222,99 @@ protected:
     } else {
       oStream << "*(p - " << -op1;
     }
-    oStream << ") += *p * " << op2 << ";\n";
+    // A 16-bit cell is promoted to int, whose product may overflow
+    oStream << (cellBits == 16 ? ") += (unsigned int) *p * " : ") += *p * ") << op2 << ";\n";
+  }
+
+  void
+  emitAddVarFromImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    emitIndent();
+    emitCell(op1);
+    oStream << " += ";
+    emitCell(op2);
+    oStream << ";\n";
+  }
+
+  void
+  emitSubVarFromImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    emitIndent();
+    emitCell(op1);
+    oStream << " -= ";
+    emitCell(op2);
+    oStream << ";\n";
+  }
+
+  void
+  emitAddAtImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    if (op2 == 0) {
+      emitAddImpl(op1);
+      return;
+    }
+    emitIndent();
+    emitCell(op2);
+    if (op1 > 0) {
+      oStream << " += " << op1 << ";\n";
+    } else {
+      oStream << " -= " << -op1 << ";\n";
+    }
+  }
+
+  void
+  emitAssignAtImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    emitIndent();
+    emitCell(op2);
+    oStream << " = " << op1 << ";\n";
+  }
+
+  void
+  emitPutcharAtImpl(int op1) CODE_GENERATOR_NOEXCEPT
+  {
+    emitIndent();
+    oStream << "putchar(";
+    emitCell(op1);
+    oStream << ");\n";
+  }
+
+  void
+  emitGetcharAtImpl(int op1) CODE_GENERATOR_NOEXCEPT
+  {
+    emitIndent();
+    emitCell(op1);
+    oStream << " = (unsigned char) getchar();\n";
+  }
+
+  void
+  emitPutStringImpl(const std::string& str) CODE_GENERATOR_NOEXCEPT
+  {
+    static const char kOctalDigits[] = "01234567";
+    emitIndent();
+    oStream << "fwrite(\n";
+    emitIndent();
+    oStream << indent << '"';
+    for (std::string::size_type i = 0; i < str.size(); i++) {
+      unsigned char c = static_cast<unsigned char>(str[i]);
+      if (c == '\n') {
+        oStream << "\\n";
+        if (i + 1 < str.size()) {
+          oStream << "\"\n";
+          emitIndent();
+          oStream << indent << '"';
+        }
+      } else if (c == '"' || c == '\\') {
+        oStream << '\\' << str[i];
+      } else if (c < 0x20 || c >= 0x7f || c == '?') {
+        oStream << '\\' << kOctalDigits[c >> 6] << kOctalDigits[(c >> 3) & 7] << kOctalDigits[c & 7];
+      } else {
+        oStream << str[i];
+      }
+    }
+    oStream << "\",\n";
+    emitIndent();
+    oStream << indent << "1, " << str.size() << ", stdout);\n";
   }
 
   void
@@ -235,6 +334,34 @@ protected:
     emitIndent();
     oStream << "debugbreak();\n";
   }
+
+private:
+  const char*
+  getCellType() const CODE_GENERATOR_NOEXCEPT
+  {
+    switch (cellBits) {
+      case 16:
+        return "uint16_t";
+      case 32:
+        return "uint32_t";
+      case 64:
+        return "uint64_t";
+      default:
+        return "unsigned char";
+    }
+  }
+
+  void
+  emitCell(int offset) CODE_GENERATOR_NOEXCEPT
+  {
+    if (offset > 0) {
+      oStream << "*(p + " << offset << ")";
+    } else if (offset < 0) {
+      oStream << "*(p - " << -offset << ")";
+    } else {
+      oStream << "*p";
+    }
+  }
 };  // class GeneratorC
 
 #endif  // GENERATOR_C_HPP
@@ -7,6 +7,7 @@
 #define GENERATOR_ELF_X64_HPP
 
 #include <iostream>
+#include <string>
 
 #include "BinaryGenerator.hpp"
 #include "util/elfsubset.h"
@@ -23,6 +24,11 @@ private:
   static const Elf64_Addr kBaseAddr = 0x04048000;
   //! Address of .bss section
   static const Elf64_Addr kBssAddr = 0x04248000;
+  //! The number of cells of the tape in .bss section (doubled for the
+  //! bidirectional tape)
+  static const Elf64_Addr kTapeSize = 0x00010000;
+  //! Size of output buffer
+  static const Elf64_Addr kOutputBufferSize = 0x00010000;
   //! Number of program headers
   static const Elf64_Half kNProgramHeaders = 2;
   //! Number of section headers
@@ -34,10 +40,14 @@ private:
 
 public:
   explicit GeneratorElfX64(std::ostream& oStream) CODE_GENERATOR_NOEXCEPT :
-    BinaryGenerator<GeneratorElfX64>(oStream)
+    BinaryGenerator<GeneratorElfX64>(oStream),
+    flushPos()
   {}
 
 private:
+  //! Position of the subroutine which writes out the output buffer
+  std::ostream::pos_type flushPos;
+
   void
   emitHeaderImpl() CODE_GENERATOR_NOEXCEPT
   {
@@ -45,14 +55,58 @@ private:
     skip(sizeof(Elf64_Ehdr) + sizeof(Elf64_Phdr) * kNProgramHeaders);
 
     // - - - - - The start of program body - - - - - //
-    // movabs rsi, {kBssAddr}
+    // movabs rsi, {tapeAddr}
     u8 opcode1[] = {0x48, 0xbe};
     write(opcode1);
-    write(static_cast<u64>(kBssAddr));
+    write(getTapeAddr());
     // mov edx, 0x01
     u8 opcode2[] = {0xba};
     write(opcode2);
     write(static_cast<u32>(0x01));
+    // mov ebx, {outputBufferAddr}
+    u8 opcode3[] = {0xbb};
+    write(opcode3);
+    write(static_cast<u32>(getOutputBufferAddr()));
+
+    // Subroutine which writes out the bytes in the output buffer up to rbx
+    // and rewinds rbx.  rsi and edx are preserved for the caller.
+    // jmp {flush_end} (short jump)
+    u8 opcode4[] = {0xeb, 0x24};
+    write(opcode4);
+    flushPos = oStream.tellp();
+    // push rsi
+    // mov rdx, rbx
+    u8 opcode5[] = {0x56, 0x48, 0x89, 0xda};
+    write(opcode5);
+    // mov esi, {outputBufferAddr}
+    u8 opcode6[] = {0xbe};
+    write(opcode6);
+    write(static_cast<u32>(getOutputBufferAddr()));
+    // sub rdx, rsi
+    // jz {flush_done}
+    u8 opcode7[] = {0x48, 0x29, 0xf2, 0x74, 0x0f};
+    write(opcode7);
+    // mov eax, 0x01
+    u8 opcode8[] = {0xb8};
+    write(opcode8);
+    write(static_cast<u32>(0x01));
+    // mov edi, 0x01
+    u8 opcode9[] = {0xbf};
+    write(opcode9);
+    write(static_cast<u32>(0x01));
+    // syscall
+    // mov rbx, rsi
+    u8 opcode10[] = {0x0f, 0x05, 0x48, 0x89, 0xf3};
+    write(opcode10);
+    // flush_done:
+    // mov edx, 0x01
+    write(opcode2);
+    write(static_cast<u32>(0x01));
+    // pop rsi
+    // ret
+    u8 opcode11[] = {0x5e, 0xc3};
+    write(opcode11);
+    // flush_end:
   }
 
   void
@@ -61,6 +115,7 @@ private:
     // Emit newline
     emitAssignImpl('\n');
     emitPutcharImpl();
+    emitCallFlush();
 
     // mov eax, 0x3c
     u8 opcode1[] = {0xb8};
@@ -127,7 +182,7 @@ private:
     shdr.sh_flags = SHF_ALLOC | SHF_WRITE;
     shdr.sh_addr = kBssAddr;
     shdr.sh_offset = 0x0000000000001000;
-    shdr.sh_size = 0x0000000000010000;  // 65536 cells
+    shdr.sh_size = getOutputBufferAddr() + kOutputBufferSize - kBssAddr;  // Cells and output buffer
     shdr.sh_link = 0x00000000;
     shdr.sh_info = 0x00000000;
     shdr.sh_addralign = 0x0000000000000010;
@@ -183,7 +238,7 @@ private:
     phdr.p_vaddr = kBssAddr;
     phdr.p_paddr = kBssAddr;
     phdr.p_filesz = 0x0000000000000000;
-    phdr.p_memsz = 0x0000000000010000;
+    phdr.p_memsz = getOutputBufferAddr() + kOutputBufferSize - kBssAddr;
     phdr.p_align = 0x0000000000001000;
     write(phdr);
 
@@ -193,6 +248,7 @@ private:
   void
   emitMovePointerImpl(int op1) CODE_GENERATOR_NOEXCEPT
   {
+    op1 *= getCellBytes();
     if (op1 > 0) {
       if (op1 > 127) {
         // add rsi, {op1}
@@ -233,25 +289,25 @@ private:
   {
     if (op1 > 0) {
       if (op1 > 1) {
-        // add byte ptr [rsi], {op1}
-        u8 opcode[] = {0x80, 0x06};
-        write(opcode);
-        write(static_cast<u8>(op1));
+        // add cell ptr [rsi], {op1}
+        writeCellOpcode(0x80);
+        write<u8>(0x06);
+        writeCellImm(op1);
       } else {
-        // inc byte ptr [rsi]
-        u8 opcode[] = {0xfe, 0x06};
-        write(opcode);
+        // inc cell ptr [rsi]
+        writeCellOpcode(0xfe);
+        write<u8>(0x06);
       }
     } else {
       if (op1 < -1) {
-        // sub byte ptr [rsi], {op1}
-        u8 opcode[] = {0x80, 0x2e};
-        write(opcode);
-        write(static_cast<u8>(-op1));
+        // sub cell ptr [rsi], {op1}
+        writeCellOpcode(0x80);
+        write<u8>(0x2e);
+        writeCellImm(-op1);
       } else {
-        // dec byte ptr [rsi]
-        u8 opcode[] = {0xfe, 0x0e};
-        write(opcode);
+        // dec cell ptr [rsi]
+        writeCellOpcode(0xfe);
+        write<u8>(0x0e);
       }
     }
   }
@@ -259,22 +315,65 @@ private:
   void
   emitPutcharImpl() CODE_GENERATOR_NOEXCEPT
   {
-    // mov rax, 0x01
-    u8 opcode1[] = {0x48, 0xc7, 0xc0};
+    // The lowest byte of the cell
+    // mov al, byte ptr [rsi]
+    // mov byte ptr [rbx], al
+    // inc rbx
+    u8 opcode1[] = {0x8a, 0x06, 0x88, 0x03, 0x48, 0xff, 0xc3};
     write(opcode1);
+    // cmp rbx, {outputBufferAddr + kOutputBufferSize}
+    u8 opcode2[] = {0x48, 0x81, 0xfb};
+    write(opcode2);
+    write(static_cast<u32>(getOutputBufferAddr() + kOutputBufferSize));
+    // jne {next} (short jump)
+    u8 opcode3[] = {0x75, 0x05};
+    write(opcode3);
+    emitCallFlush();
+  }
+
+  void
+  emitPutStringImpl(const std::string& str) CODE_GENERATOR_NOEXCEPT
+  {
+    // The string is written directly since the output buffer is still empty
+    // at the beginning of the program
+    // jmp 0x********
+    u8 opcode1[] = {0xe9};
+    write(opcode1);
+    write(static_cast<u32>(str.size()));
+    // The string is embedded in .text
+    Elf64_Addr strAddr = kBaseAddr + static_cast<Elf64_Addr>(oStream.tellp());
+    write(str.data(), str.size());
+    // mov eax, 0x01
+    u8 opcode2[] = {0xb8};
+    write(opcode2);
     write(static_cast<u32>(0x01));
     // mov edi, 0x01
-    u8 opcode2[] = {0xbf};
-    write(opcode2);
+    u8 opcode3[] = {0xbf};
+    write(opcode3);
     write(static_cast<u32>(0x01));
+    // movabs rsi, {strAddr}
+    u8 opcode4[] = {0x48, 0xbe};
+    write(opcode4);
+    write(strAddr);
+    // mov edx, {str.size()}
+    u8 opcode5[] = {0xba};
+    write(opcode5);
+    write(static_cast<u32>(str.size()));
     // syscall
-    u8 opcode3[] = {0x0f, 0x05};
-    write(opcode3);
+    u8 opcode6[] = {0x0f, 0x05};
+    write(opcode6);
+    // movabs rsi, {tapeAddr}
+    write(opcode4);
+    write(getTapeAddr());
+    // mov edx, 0x01
+    write(opcode5);
+    write(static_cast<u32>(0x01));
   }
 
   void
   emitGetcharImpl() CODE_GENERATOR_NOEXCEPT
   {
+    emitCallFlush();
     // xor rax, rax
     u8 opcode1[] = {0x48, 0x31, 0xc0};
     write(opcode1);
@@ -284,14 +383,28 @@ private:
     // syscall
     u8 opcode3[] = {0x0f, 0x05};
     write(opcode3);
+    if (cellBits != 8) {
+      // Zero-extend the byte unless the cell is left unchanged at EOF
+      // test eax, eax
+      // jle {next} (short jump)
+      u8 opcode4[] = {0x85, 0xc0, 0x7e, static_cast<u8>(cellBits == 32 ? 5 : 6)};
+      write(opcode4);
+      // movzx eax, byte ptr [rsi]
+      u8 opcode5[] = {0x0f, 0xb6, 0x06};
+      write(opcode5);
+      // mov cell ptr [rsi], eax
+      writeCellOpcode(0x88);
+      write<u8>(0x06);
+    }
   }
 
   void
   emitLoopStartImpl() CODE_GENERATOR_NOEXCEPT
   {
     loopStack.push(oStream.tellp());
-    // cmp byte ptr [rsi], 0x00
-    u8 opcode1[] = {0x80, 0x3e, 0x00};
+    // cmp cell ptr [rsi], 0x00
+    writeCellPrefix();
+    u8 opcode1[] = {static_cast<u8>(cellBits == 8 ? 0x80 : 0x83), 0x3e, 0x00};
     write(opcode1);
     // je 0x********
     u8 opcode2[] = {0x0f, 0x84};
@@ -317,7 +430,7 @@ private:
     }
     // fill loop start
     std::ostream::pos_type curPos = oStream.tellp();
-    oStream.seekp(pos + static_cast<std::ostream::pos_type>(5), std::ios_base::beg);
+    oStream.seekp(pos + getLoopJumpOffset(), std::ios_base::beg);
     write(static_cast<u32>(curPos - oStream.tellp() - sizeof(u32)));
     oStream.seekp(curPos, std::ios_base::beg);
     loopStack.pop();
@@ -329,7 +442,7 @@ private:
     // fill if jump
     std::ostream::pos_type pos = loopStack.top();
     std::ostream::pos_type curPos = oStream.tellp();
-    oStream.seekp(pos + static_cast<std::ostream::pos_type>(5), std::ios_base::beg);
+    oStream.seekp(pos + getLoopJumpOffset(), std::ios_base::beg);
     write(static_cast<u32>(curPos - oStream.tellp() - sizeof(u32)));
     oStream.seekp(curPos, std::ios_base::beg);
     loopStack.pop();
@@ -338,52 +451,47 @@ private:
   void
   emitAssignImpl(int op1) CODE_GENERATOR_NOEXCEPT
   {
-    // mov byte ptr [rsi], {op1}
-    u8 opcode[] = {0xc6, 0x06};
-    write(opcode);
-    write(static_cast<u8>(op1));
+    // mov cell ptr [rsi], {op1}
+    writeCellOpcode(0xc6);
+    write<u8>(0x06);
+    writeCellImm(op1);
   }
 
   void
   emitAddVarImpl(int op1) CODE_GENERATOR_NOEXCEPT
   {
-    // mov al, byte ptr [rsi]
-    u8 opcode1[] = {0x8a, 0x06};
-    write(opcode1);
-    // add byte ptr [rsi + {op1}], al
-    if (op1 < -128 || 127 < op1) {
-      u8 opcode2[] = {0x00, 0x86};
-      write(opcode2);
-      write(static_cast<u32>(op1));
-    } else {
-      u8 opcode2[] = {0x00, 0x46};
-      write(opcode2);
-      write(static_cast<u8>(op1));
-    }
+    // mov eax, cell ptr [rsi]
+    writeCellOpcode(0x8a);
+    write<u8>(0x06);
+    // add cell ptr [rsi + {op1}], eax
+    writeCellOpcode(0x00);
+    writeRsiDisp(0, op1 * getCellBytes());
   }
 
   void
   emitSubVarImpl(int op1) CODE_GENERATOR_NOEXCEPT
   {
-    // mov al, byte ptr [rsi]
-    u8 opcode1[] = {0x8a, 0x06};
-    write(opcode1);
-    // add byte ptr [rsi + {op1}], al
-    if (op1 < -128 || 127 < op1) {
-      u8 opcode2[] = {0x28, 0x86};
-      write(opcode2);
-      write(static_cast<u32>(op1));
-    } else {
-      u8 opcode2[] = {0x28, 0x46};
-      write(opcode2);
-      write(static_cast<u8>(op1));
-    }
+    // mov eax, cell ptr [rsi]
+    writeCellOpcode(0x8a);
+    write<u8>(0x06);
+    // sub cell ptr [rsi + {op1}], eax
+    writeCellOpcode(0x28);
+    writeRsiDisp(0, op1 * getCellBytes());
   }
 
   void
   emitAddCMulVarImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
   {
-    if (op2 > 0) {
+    if (cellBits != 8) {
+      // imul eax, cell ptr [rsi], {op2}
+      writeCellPrefix();
+      u8 opcode1[] = {0x69, 0x06};
+      write(opcode1);
+      writeCellImm(op2);
+      // add cell ptr [rsi + {op1}], eax
+      writeCellOpcode(0x00);
+      writeRsiDisp(0, op1 * getCellBytes());
+    } else if (op2 > 0) {
       // mov al, {op2}
       u8 opcode1[] = {0xb0};
       write(opcode1);
@@ -422,6 +530,51 @@ private:
     }
   }
 
+  void
+  emitAddAtImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    if (op2 == 0) {
+      emitAddImpl(op1);
+      return;
+    }
+    if (op1 > 0) {
+      if (op1 > 1) {
+        // add cell ptr [rsi + {op2}], {op1}
+        writeCellOpcode(0x80);
+        writeRsiDisp(0, op2 * getCellBytes());
+        writeCellImm(op1);
+      } else {
+        // inc cell ptr [rsi + {op2}]
+        writeCellOpcode(0xfe);
+        writeRsiDisp(0, op2 * getCellBytes());
+      }
+    } else {
+      if (op1 < -1) {
+        // sub cell ptr [rsi + {op2}], {op1}
+        writeCellOpcode(0x80);
+        writeRsiDisp(5, op2 * getCellBytes());
+        writeCellImm(-op1);
+      } else {
+        // dec cell ptr [rsi + {op2}]
+        writeCellOpcode(0xfe);
+        writeRsiDisp(1, op2 * getCellBytes());
+      }
+    }
+  }
+
+  void
+  emitAssignAtImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    if (op2 == 0) {
+      emitAssignImpl(op1);
+      return;
+    }
+    // mov cell ptr [rsi + {op2}], {op1}
+    writeCellOpcode(0xc6);
+    writeRsiDisp(0, op2 * getCellBytes());
+    writeCellImm(op1);
+  }
+
   void
   emitInfLoopImpl() CODE_GENERATOR_NOEXCEPT
   {
@@ -438,6 +591,94 @@ private:
   {
     write<u8>(0xcc);
   }
+
+  // Address of the first cell, which is in the middle of the bidirectional
+  // tape
+  Elf64_Addr
+  getTapeAddr() const CODE_GENERATOR_NOEXCEPT
+  {
+    return isBidirectionalTape ? kBssAddr + kTapeSize * static_cast<Elf64_Addr>(getCellBytes()) : kBssAddr;
+  }
+
+  // Address of output buffer, which follows the tape in .bss section
+  Elf64_Addr
+  getOutputBufferAddr() const CODE_GENERATOR_NOEXCEPT
+  {
+    return kBssAddr + (isBidirectionalTape ? kTapeSize * 2 : kTapeSize) * static_cast<Elf64_Addr>(getCellBytes());
+  }
+
+  // Size of a cell in bytes
+  int
+  getCellBytes() const CODE_GENERATOR_NOEXCEPT
+  {
+    return cellBits / 8;
+  }
+
+  // Offset of the displacement of je from the start of a loop, which is
+  // after cmp
+  std::streamoff
+  getLoopJumpOffset() const CODE_GENERATOR_NOEXCEPT
+  {
+    return cellBits == 16 || cellBits == 64 ? 6 : 5;
+  }
+
+  // Write the operand-size prefix of a cell: 0x66 for 16-bit cells and REX.W
+  // for 64-bit cells
+  void
+  writeCellPrefix() CODE_GENERATOR_NOEXCEPT
+  {
+    if (cellBits == 16) {
+      write<u8>(0x66);
+    } else if (cellBits == 64) {
+      write<u8>(0x48);
+    }
+  }
+
+  // Write the prefix and the opcode of an instruction on a cell, where
+  // opcode is the byte form and opcode + 1 is the wider form
+  void
+  writeCellOpcode(u8 opcode) CODE_GENERATOR_NOEXCEPT
+  {
+    writeCellPrefix();
+    write(static_cast<u8>(cellBits == 8 ? opcode : opcode + 1));
+  }
+
+  // Write an immediate of an instruction on a cell, which is sign-extended
+  // for 64-bit cells
+  void
+  writeCellImm(int imm) CODE_GENERATOR_NOEXCEPT
+  {
+    if (cellBits == 8) {
+      write(static_cast<u8>(imm));
+    } else if (cellBits == 16) {
+      write(static_cast<u16>(imm));
+    } else {
+      write(static_cast<u32>(imm));
+    }
+  }
+
+  // Call the subroutine which writes out the output buffer
+  void
+  emitCallFlush() CODE_GENERATOR_NOEXCEPT
+  {
+    // call {flushPos}
+    u8 opcode = {0xe8};
+    write(opcode);
+    write(static_cast<u32>(flushPos - oStream.tellp() - static_cast<std::streamoff>(sizeof(u32))));
+  }
+
+  // Write ModR/M byte and displacement of [rsi + {disp}]
+  void
+  writeRsiDisp(u8 reg, int disp) CODE_GENERATOR_NOEXCEPT
+  {
+    if (disp < -128 || 127 < disp) {
+      write(static_cast<u8>(0x86 | (reg << 3)));
+      write(static_cast<u32>(disp));
+    } else {
+      write(static_cast<u8>(0x46 | (reg << 3)));
+      write(static_cast<u8>(disp));
+    }
+  }
 };  // class GeneratorElfX64
 
 
@@ -7,6 +7,7 @@
 #define GENERATOR_ELF_X86_HPP
 
 #include <iostream>
+#include <string>
 
 #include "BinaryGenerator.hpp"
 #include "util/elfsubset.h"
@@ -23,6 +24,11 @@ private:
   static const Elf32_Addr kBaseAddr = 0x04048000;
   //! Address of .bss section
   static const Elf32_Addr kBssAddr = 0x04248000;
+  //! The number of cells of the tape in .bss section (doubled for the
+  //! bidirectional tape)
+  static const Elf32_Addr kTapeSize = 0x00010000;
+  //! Size of output buffer
+  static const Elf32_Addr kOutputBufferSize = 0x00010000;
   //! Number of program headers
   static const Elf32_Half kNProgramHeaders = 2;
   //! Number of section headers
@@ -34,10 +40,14 @@ private:
 
 public:
   explicit GeneratorElfX86(std::ostream& oStream) CODE_GENERATOR_NOEXCEPT :
-    BinaryGenerator<GeneratorElfX86>(oStream)
+    BinaryGenerator<GeneratorElfX86>(oStream),
+    flushPos()
   {}
 
 private:
+  //! Position of the subroutine which writes out the output buffer
+  std::ostream::pos_type flushPos;
+
   void
   emitHeaderImpl() CODE_GENERATOR_NOEXCEPT
   {
@@ -45,14 +55,58 @@ private:
     skip(sizeof(Elf32_Ehdr) + sizeof(Elf32_Phdr) * kNProgramHeaders);
 
     // - - - - - The start of program body - - - - - //
-    // mov ecx, {kBssAddr}
+    // mov ecx, {tapeAddr}
     u8 opcode1[] = {0xb9};
     write(opcode1);
-    write(static_cast<u32>(kBssAddr));
+    write(getTapeAddr());
     // mov edx, 0x01
     u8 opcode2[] = {0xba};
     write(opcode2);
     write(static_cast<u32>(0x01));
+    // mov edi, {outputBufferAddr}
+    u8 opcode3[] = {0xbf};
+    write(opcode3);
+    write(getOutputBufferAddr());
+
+    // Subroutine which writes out the bytes in the output buffer up to edi
+    // and rewinds edi.  ecx and edx are preserved for the caller.
+    // jmp {flush_end} (short jump)
+    u8 opcode4[] = {0xeb, 0x21};
+    write(opcode4);
+    flushPos = oStream.tellp();
+    // push ecx
+    // mov edx, edi
+    u8 opcode5[] = {0x51, 0x89, 0xfa};
+    write(opcode5);
+    // mov ecx, {outputBufferAddr}
+    u8 opcode6[] = {0xb9};
+    write(opcode6);
+    write(getOutputBufferAddr());
+    // sub edx, ecx
+    // jz {flush_done}
+    u8 opcode7[] = {0x29, 0xca, 0x74, 0x0e};
+    write(opcode7);
+    // mov eax, 0x04
+    u8 opcode8[] = {0xb8};
+    write(opcode8);
+    write(static_cast<u32>(0x04));
+    // mov ebx, 0x01
+    u8 opcode9[] = {0xbb};
+    write(opcode9);
+    write(static_cast<u32>(0x01));
+    // int 0x80
+    // mov edi, ecx
+    u8 opcode10[] = {0xcd, 0x80, 0x89, 0xcf};
+    write(opcode10);
+    // flush_done:
+    // mov edx, 0x01
+    write(opcode2);
+    write(static_cast<u32>(0x01));
+    // pop ecx
+    // ret
+    u8 opcode11[] = {0x59, 0xc3};
+    write(opcode11);
+    // flush_end:
   }
 
   void
@@ -61,6 +115,7 @@ private:
     // Emit newline
     emitAssignImpl('\n');
     emitPutcharImpl();
+    emitCallFlush();
 
     // mov eax, 0x01
     u8 opcode1[] = {0xb8};
@@ -127,7 +182,7 @@ private:
     shdr.sh_flags = SHF_ALLOC | SHF_WRITE;
     shdr.sh_addr = kBssAddr;
     shdr.sh_offset = 0x00001000;
-    shdr.sh_size = 0x00010000;  // 65536 cells
+    shdr.sh_size = getOutputBufferAddr() + kOutputBufferSize - kBssAddr;  // Cells and output buffer
     shdr.sh_link = 0x00000000;
     shdr.sh_info = 0x00000000;
     shdr.sh_addralign = 0x00000010;
@@ -183,7 +238,7 @@ private:
     phdr.p_vaddr = kBssAddr;
     phdr.p_paddr = kBssAddr;
     phdr.p_filesz = 0x00000000;
-    phdr.p_memsz = 0x00010000;
+    phdr.p_memsz = getOutputBufferAddr() + kOutputBufferSize - kBssAddr;
     phdr.p_align = 0x00001000;
     write(phdr);
 
@@ -193,6 +248,7 @@ private:
   void
   emitMovePointerImpl(int op1) CODE_GENERATOR_NOEXCEPT
   {
+    op1 *= getCellBytes();
     if (op1 > 0) {
       if (op1 > 127) {
         // add ecx, {op1}
@@ -233,25 +289,25 @@ private:
   {
     if (op1 > 0) {
       if (op1 > 1) {
-        // add byte ptr [ecx], {op1}
-        u8 opcode[] = {0x80, 0x01};
-        write(opcode);
-        write(static_cast<u8>(op1));
+        // add cell ptr [ecx], {op1}
+        writeCellOpcode(0x80);
+        write<u8>(0x01);
+        writeCellImm(op1);
       } else {
-        // inc byte ptr [ecx]
-        u8 opcode[] = {0xfe, 0x01};
-        write(opcode);
+        // inc cell ptr [ecx]
+        writeCellOpcode(0xfe);
+        write<u8>(0x01);
       }
     } else {
       if (op1 < -1) {
-        // sub byte ptr [ecx], {op1}
-        u8 opcode[] = {0x80, 0x29};
-        write(opcode);
-        write(static_cast<u8>(-op1));
+        // sub cell ptr [ecx], {op1}
+        writeCellOpcode(0x80);
+        write<u8>(0x29);
+        writeCellImm(-op1);
       } else {
-        // dec byte ptr [ecx]
-        u8 opcode[] = {0xfe, 0x09};
-        write(opcode);
+        // dec cell ptr [ecx]
+        writeCellOpcode(0xfe);
+        write<u8>(0x09);
       }
     }
   }
@@ -259,22 +315,65 @@ private:
   void
   emitPutcharImpl() CODE_GENERATOR_NOEXCEPT
   {
-    // mov eax, 0x04
-    u8 opcode1[] = {0xb8};
+    // The lowest byte of the cell
+    // mov al, byte ptr [ecx]
+    // mov byte ptr [edi], al
+    // inc edi
+    u8 opcode1[] = {0x8a, 0x01, 0x88, 0x07, 0x47};
     write(opcode1);
+    // cmp edi, {outputBufferAddr + kOutputBufferSize}
+    u8 opcode2[] = {0x81, 0xff};
+    write(opcode2);
+    write(getOutputBufferAddr() + kOutputBufferSize);
+    // jne {next} (short jump)
+    u8 opcode3[] = {0x75, 0x05};
+    write(opcode3);
+    emitCallFlush();
+  }
+
+  void
+  emitPutStringImpl(const std::string& str) CODE_GENERATOR_NOEXCEPT
+  {
+    // The string is written directly since the output buffer is still empty
+    // at the beginning of the program
+    // jmp 0x********
+    u8 opcode1[] = {0xe9};
+    write(opcode1);
+    write(static_cast<u32>(str.size()));
+    // The string is embedded in .text
+    Elf32_Addr strAddr = kBaseAddr + static_cast<Elf32_Addr>(oStream.tellp());
+    write(str.data(), str.size());
+    // mov eax, 0x04
+    u8 opcode2[] = {0xb8};
+    write(opcode2);
     write(static_cast<u32>(0x04));
     // mov ebx, 0x01
-    u8 opcode2[] = {0xbb};
-    write(opcode2);
+    u8 opcode3[] = {0xbb};
+    write(opcode3);
     write(static_cast<u32>(0x01));
+    // mov ecx, {strAddr}
+    u8 opcode4[] = {0xb9};
+    write(opcode4);
+    write(strAddr);
+    // mov edx, {str.size()}
+    u8 opcode5[] = {0xba};
+    write(opcode5);
+    write(static_cast<u32>(str.size()));
     // int 0x80
-    u8 opcode3[] = {0xcd, 0x80};
-    write(opcode3);
+    u8 opcode6[] = {0xcd, 0x80};
+    write(opcode6);
+    // mov ecx, {tapeAddr}
+    write(opcode4);
+    write(getTapeAddr());
+    // mov edx, 0x01
+    write(opcode5);
+    write(static_cast<u32>(0x01));
   }
 
   void
   emitGetcharImpl() CODE_GENERATOR_NOEXCEPT
   {
+    emitCallFlush();
     // mov eax, 0x03
     u8 opcode1[] = {0xb8};
     write(opcode1);
@@ -285,14 +384,28 @@ private:
     // int 0x80
     u8 opcode3[] = {0xcd, 0x80};
     write(opcode3);
+    if (cellBits != 8) {
+      // Zero-extend the byte unless the cell is left unchanged at EOF
+      // test eax, eax
+      // jle {next} (short jump)
+      u8 opcode4[] = {0x85, 0xc0, 0x7e, static_cast<u8>(cellBits == 32 ? 5 : 6)};
+      write(opcode4);
+      // movzx eax, byte ptr [ecx]
+      u8 opcode5[] = {0x0f, 0xb6, 0x01};
+      write(opcode5);
+      // mov cell ptr [ecx], eax
+      writeCellOpcode(0x88);
+      write<u8>(0x01);
+    }
   }
 
   void
   emitLoopStartImpl() CODE_GENERATOR_NOEXCEPT
   {
     loopStack.push(oStream.tellp());
-    // cmp byte ptr [ecx], 0x00
-    u8 opcode1[] = {0x80, 0x39};
+    // cmp cell ptr [ecx], 0x00
+    writeCellPrefix();
+    u8 opcode1[] = {static_cast<u8>(cellBits == 8 ? 0x80 : 0x83), 0x39};
     write(opcode1);
     write(static_cast<u8>(0x00));
     // je 0x********
@@ -319,7 +432,7 @@ private:
     }
     // fill loop start
     std::ostream::pos_type curPos = oStream.tellp();
-    oStream.seekp(pos + static_cast<std::ostream::pos_type>(5), std::ios_base::beg);
+    oStream.seekp(pos + getLoopJumpOffset(), std::ios_base::beg);
     write(static_cast<u32>(curPos - oStream.tellp() - sizeof(u32)));
     oStream.seekp(curPos, std::ios_base::beg);
     loopStack.pop();
@@ -331,7 +444,7 @@ private:
     // fill if jump
     std::ostream::pos_type pos = loopStack.top();
     std::ostream::pos_type curPos = oStream.tellp();
-    oStream.seekp(pos + static_cast<std::ostream::pos_type>(5), std::ios_base::beg);
+    oStream.seekp(pos + getLoopJumpOffset(), std::ios_base::beg);
     write(static_cast<u32>(curPos - oStream.tellp() - sizeof(u32)));
     oStream.seekp(curPos, std::ios_base::beg);
     loopStack.pop();
@@ -340,52 +453,47 @@ private:
   void
   emitAssignImpl(int op1) CODE_GENERATOR_NOEXCEPT
   {
-    // mov byte ptr [ecx], {op1}
-    u8 opcode[] = {0xc6, 0x01};
-    write(opcode);
-    write(static_cast<u8>(op1));
+    // mov cell ptr [ecx], {op1}
+    writeCellOpcode(0xc6);
+    write<u8>(0x01);
+    writeCellImm(op1);
   }
 
   void
   emitAddVarImpl(int op1) CODE_GENERATOR_NOEXCEPT
   {
-    // mov al, byte ptr [ecx]
-    u8 opcode1[] = {0x8a, 0x01};
-    write(opcode1);
-    // add byte ptr [ecx + {op1}], al
-    if (op1 < -128 || 127 < op1) {
-      u8 opcode2[] = {0x00, 0x81};
-      write(opcode2);
-      write(static_cast<u32>(op1));
-    } else {
-      u8 opcode2[] = {0x00, 0x41};
-      write(opcode2);
-      write(static_cast<u8>(op1));
-    }
+    // mov eax, cell ptr [ecx]
+    writeCellOpcode(0x8a);
+    write<u8>(0x01);
+    // add cell ptr [ecx + {op1}], eax
+    writeCellOpcode(0x00);
+    writeEcxDisp(0, op1 * getCellBytes());
   }
 
   void
   emitSubVarImpl(int op1) CODE_GENERATOR_NOEXCEPT
   {
-    // mov al, byte ptr [ecx]
-    u8 opcode1[] = {0x8a, 0x01};
-    write(opcode1);
-    // sub byte ptr [rbx + {op1}], al
-    if (op1 < -128 || 127 < op1) {
-      u8 opcode2[] = {0x28, 0x81};
-      write(opcode2);
-      write(static_cast<u32>(op1));
-    } else {
-      u8 opcode2[] = {0x28, 0x41};
-      write(opcode2);
-      write(static_cast<u8>(op1));
-    }
+    // mov eax, cell ptr [ecx]
+    writeCellOpcode(0x8a);
+    write<u8>(0x01);
+    // sub cell ptr [ecx + {op1}], eax
+    writeCellOpcode(0x28);
+    writeEcxDisp(0, op1 * getCellBytes());
   }
 
   void
   emitAddCMulVarImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
   {
-    if (op2 > 0) {
+    if (cellBits != 8) {
+      // imul eax, cell ptr [ecx], {op2}
+      writeCellPrefix();
+      u8 opcode1[] = {0x69, 0x01};
+      write(opcode1);
+      writeCellImm(op2);
+      // add cell ptr [ecx + {op1}], eax
+      writeCellOpcode(0x00);
+      writeEcxDisp(0, op1 * getCellBytes());
+    } else if (op2 > 0) {
       // mov al, {op2}
       u8 opcode1[] = {0xb0};
       write(opcode1);
@@ -424,6 +532,51 @@ private:
     }
   }
 
+  void
+  emitAddAtImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    if (op2 == 0) {
+      emitAddImpl(op1);
+      return;
+    }
+    if (op1 > 0) {
+      if (op1 > 1) {
+        // add cell ptr [ecx + {op2}], {op1}
+        writeCellOpcode(0x80);
+        writeEcxDisp(0, op2 * getCellBytes());
+        writeCellImm(op1);
+      } else {
+        // inc cell ptr [ecx + {op2}]
+        writeCellOpcode(0xfe);
+        writeEcxDisp(0, op2 * getCellBytes());
+      }
+    } else {
+      if (op1 < -1) {
+        // sub cell ptr [ecx + {op2}], {op1}
+        writeCellOpcode(0x80);
+        writeEcxDisp(5, op2 * getCellBytes());
+        writeCellImm(-op1);
+      } else {
+        // dec cell ptr [ecx + {op2}]
+        writeCellOpcode(0xfe);
+        writeEcxDisp(1, op2 * getCellBytes());
+      }
+    }
+  }
+
+  void
+  emitAssignAtImpl(int op1, int op2) CODE_GENERATOR_NOEXCEPT
+  {
+    if (op2 == 0) {
+      emitAssignImpl(op1);
+      return;
+    }
+    // mov cell ptr [ecx + {op2}], {op1}
+    writeCellOpcode(0xc6);
+    writeEcxDisp(0, op2 * getCellBytes());
+    writeCellImm(op1);
+  }
+
   void
   emitInfLoopImpl() CODE_GENERATOR_NOEXCEPT
   {
@@ -440,6 +593,91 @@ private:
   {
     write<u8>(0xcc);
   }
+
+  // Address of the first cell, which is in the middle of the bidirectional
+  // tape
+  Elf32_Addr
+  getTapeAddr() const CODE_GENERATOR_NOEXCEPT
+  {
+    return isBidirectionalTape ? kBssAddr + kTapeSize * static_cast<Elf32_Addr>(getCellBytes()) : kBssAddr;
+  }
+
+  // Address of output buffer, which follows the tape in .bss section
+  Elf32_Addr
+  getOutputBufferAddr() const CODE_GENERATOR_NOEXCEPT
+  {
+    return kBssAddr + (isBidirectionalTape ? kTapeSize * 2 : kTapeSize) * static_cast<Elf32_Addr>(getCellBytes());
+  }
+
+  // Size of a cell in bytes
+  int
+  getCellBytes() const CODE_GENERATOR_NOEXCEPT
+  {
+    return cellBits / 8;
+  }
+
+  // Offset of the displacement of je from the start of a loop, which is
+  // after cmp
+  std::streamoff
+  getLoopJumpOffset() const CODE_GENERATOR_NOEXCEPT
+  {
+    return cellBits == 16 ? 6 : 5;
+  }
+
+  // Write the operand-size prefix of a cell: 0x66 for 16-bit cells
+  // (64-bit cells are not supported)
+  void
+  writeCellPrefix() CODE_GENERATOR_NOEXCEPT
+  {
+    if (cellBits == 16) {
+      write<u8>(0x66);
+    }
+  }
+
+  // Write the prefix and the opcode of an instruction on a cell, where
+  // opcode is the byte form and opcode + 1 is the wider form
+  void
+  writeCellOpcode(u8 opcode) CODE_GENERATOR_NOEXCEPT
+  {
+    writeCellPrefix();
+    write(static_cast<u8>(cellBits == 8 ? opcode : opcode + 1));
+  }
+
+  // Write an immediate of an instruction on a cell
+  void
+  writeCellImm(int imm) CODE_GENERATOR_NOEXCEPT
+  {
+    if (cellBits == 8) {
+      write(static_cast<u8>(imm));
+    } else if (cellBits == 16) {
+      write(static_cast<u16>(imm));
+    } else {
+      write(static_cast<u32>(imm));
+    }
+  }
+
+  // Call the subroutine which writes out the output buffer
+  void
+  emitCallFlush() CODE_GENERATOR_NOEXCEPT
+  {
+    // call {flushPos}
+    u8 opcode = {0xe8};
+    write(opcode);
+    write(static_cast<u32>(flushPos - oStream.tellp() - static_cast<std::streamoff>(sizeof(u32))));
+  }
+
+  // Write ModR/M byte and displacement of [ecx + {disp}]
+  void
+  writeEcxDisp(u8 reg, int disp) CODE_GENERATOR_NOEXCEPT
+  {
+    if (disp < -128 || 127 < disp) {
+      write(static_cast<u8>(0x81 | (reg << 3)));
+      write(static_cast<u32>(disp));
+    } else {
+      write(static_cast<u8>(0x41 | (reg << 3)));
+      write(static_cast<u8>(disp));
+    }
+  }
 };  // class GeneratorElfX86
 
 
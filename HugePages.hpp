@@ -0,0 +1,90 @@
+/*!
+ * @file HugePages.hpp
+ * @brief Memory mapping backed by huge pages
+ * @author koturn
+ */
+#ifndef HUGE_PAGES_HPP
+#define HUGE_PAGES_HPP  //!< Include guard
+
+#include <cstddef>
+#if !defined(_WIN32)
+#  include <sys/mman.h>
+#  if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#    define MAP_ANONYMOUS  MAP_ANON
+#  endif  // !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#  if !defined(MAP_NORESERVE)
+#    define MAP_NORESERVE  0
+#  endif  // !defined(MAP_NORESERVE)
+#endif  // !defined(_WIN32)
+
+#if defined(__cplusplus) && __cplusplus >= 201103 \
+  || defined(_MSC_VER) && (_MSC_VER > 1800 || (_MSC_VER == 1800 && _MSC_FULL_VER == 180021114))
+//! Polyfill macro of @code noexcept @endcode
+#  define HUGE_PAGES_NOEXCEPT  noexcept
+#else
+//! Polyfill macro of @code noexcept @endcode
+#  define HUGE_PAGES_NOEXCEPT  throw()
+#endif
+
+
+/*!
+ * @class HugePages
+ * @brief Mapper of memory regions backed by huge pages
+ *
+ * A region is mapped from the hugetlb pool (MAP_HUGETLB) if the pool has
+ * enough pages, otherwise it is aligned to kSize and transparent huge pages
+ * are requested with madvise(MADV_HUGEPAGE).
+ * Unmap the region with munmap().
+ */
+class HugePages
+{
+public:
+  //! Size of a huge page
+  static const std::size_t kSize = 2 * 1024 * 1024;
+
+  /*!
+   * @brief Map an anonymous region backed by huge pages
+   * @param [in] size  Size of the region, which must be a multiple of kSize
+   * @param [in] prot  Protection of the region
+   * @return Start of the region aligned to kSize, or NULL if huge pages are
+   *         not available on this platform or the mapping failed
+   */
+  static void*
+  map(std::size_t size, int prot) HUGE_PAGES_NOEXCEPT
+  {
+#if defined(_WIN32) || !defined(MAP_HUGETLB) && !defined(MADV_HUGEPAGE)
+    static_cast<void>(size);
+    static_cast<void>(prot);
+    return NULL;
+#else
+#  if defined(MAP_HUGETLB)
+    void* p = mmap(NULL, size, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+      return p;
+    }
+#  endif  // defined(MAP_HUGETLB)
+#  if defined(MADV_HUGEPAGE)
+    // Map one more huge page and trim it to align the region
+    void* q = mmap(NULL, size + kSize, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (q == MAP_FAILED) {
+      return NULL;
+    }
+    unsigned char* head = static_cast<unsigned char*>(q);
+    unsigned char* start = head + (kSize - reinterpret_cast<std::size_t>(head) % kSize) % kSize;
+    if (start != head) {
+      munmap(head, static_cast<std::size_t>(start - head));
+    }
+    if (start + size != head + size + kSize) {
+      munmap(start + size, static_cast<std::size_t>(head + kSize - start));
+    }
+    madvise(start, size, MADV_HUGEPAGE);
+    return start;
+#  else
+    return NULL;
+#  endif  // defined(MADV_HUGEPAGE)
+#endif  // defined(_WIN32) || !defined(MAP_HUGETLB) && !defined(MADV_HUGEPAGE)
+  }
+};  // class HugePages
+
+
+#endif  // HUGE_PAGES_HPP
@@ -0,0 +1,369 @@
+/*!
+ * @file IRFile.hpp
+ * @brief Binary file format of brainfuck IR code
+ * @author koturn
+ */
+#ifndef IR_FILE_HPP
+#define IR_FILE_HPP  //!< Include guard
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+#  include <cstdint>
+#else
+#  include <stdint.h>
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+#if !defined(_WIN32)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif  // !defined(_WIN32)
+
+#include "BfInst.h"
+
+#if defined(__cplusplus) && __cplusplus >= 201103 \
+  || defined(_MSC_VER) && (_MSC_VER > 1800 || (_MSC_VER == 1800 && _MSC_FULL_VER == 180021114))
+//! Polyfill macro of @code noexcept @endcode
+#  define IR_FILE_NOEXCEPT  noexcept
+#else
+//! Polyfill macro of @code noexcept @endcode
+#  define IR_FILE_NOEXCEPT  throw()
+#endif
+
+
+/*!
+ * @class IRFile
+ * @brief Reader and writer of .bfir files
+ *
+ * A .bfir file consists of a header and a payload, and all integers are
+ * little-endian.
+ * The header has the magic number, the format version, the cell width, the
+ * numbers of the items in the payload and the FNV-1a hash of the payload as
+ * the checksum.
+ * The payload has the instructions (type, op1 and op2 in 32 bits each), the
+ * output of the prefix executed at compile time, and an optional table of
+ * 32-bit source offsets, one per instruction.
+ * A file is mapped with mmap() and checked when it is opened, and
+ * std::runtime_error is thrown if it is broken.
+ */
+class IRFile
+{
+public:
+  //! Version of the format
+  static const std::uint32_t kVersion = 1;
+
+  /*!
+   * @brief Ctor: map and check a file
+   * @param [in] filename  File name
+   */
+  explicit IRFile(const std::string& filename) :
+    mapping(NULL),
+    buffer(),
+    data(NULL),
+    size(0),
+    cellBits(0),
+    instructionCount(0),
+    prefixSize(0),
+    offsetCount(0)
+  {
+#if defined(_WIN32)
+    std::ifstream ifs(filename.c_str(), std::ios::binary);
+    if (!ifs.is_open()) {
+      throw std::runtime_error("Failed to open: " + filename);
+    }
+    buffer.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    data = reinterpret_cast<const unsigned char*>(buffer.data());
+    size = buffer.size();
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+      throw std::runtime_error("Failed to open: " + filename);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      throw std::runtime_error("Failed to open: " + filename);
+    }
+    size = static_cast<std::size_t>(st.st_size);
+    if (size > 0) {
+      mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+      mapping = NULL;
+      throw std::runtime_error("Failed to map: " + filename);
+    }
+    data = static_cast<const unsigned char*>(mapping);
+#endif  // defined(_WIN32)
+    if (!check()) {
+      release();
+      throw std::runtime_error("Invalid IR file: " + filename);
+    }
+  }
+
+  /*!
+   * @brief Dtor: unmap the file
+   */
+  ~IRFile()
+  {
+    release();
+  }
+
+  /*!
+   * @brief Serialize IR code in the format of .bfir files
+   * @param [in] ircode         IR code
+   * @param [in] prefixOutput   Output of the prefix executed at compile time
+   * @param [in] cellBits       Width of a cell in bits
+   * @param [in] sourceOffsets  Offset in the source code of each instruction,
+   *                            or empty if they are unknown
+   * @return The content of a .bfir file
+   */
+  static std::string
+  serialize(const std::vector<BfInst>& ircode, const std::string& prefixOutput, int cellBits,
+      const std::vector<std::uint32_t>& sourceOffsets=std::vector<std::uint32_t>())
+  {
+    std::string payload;
+    payload.reserve(ircode.size() * kInstructionSize + prefixOutput.size() + sourceOffsets.size() * 4);
+    for (std::vector<BfInst>::const_iterator itr = ircode.begin(); itr != ircode.end(); ++itr) {
+      appendInt(payload, static_cast<std::uint32_t>(itr->type), 4);
+      appendInt(payload, static_cast<std::uint32_t>(itr->op1), 4);
+      appendInt(payload, static_cast<std::uint32_t>(itr->op2), 4);
+    }
+    payload += prefixOutput;
+    for (std::vector<std::uint32_t>::const_iterator itr = sourceOffsets.begin(); itr != sourceOffsets.end(); ++itr) {
+      appendInt(payload, *itr, 4);
+    }
+    std::string content(getMagic(), 8);
+    appendInt(content, kVersion, 4);
+    appendInt(content, static_cast<std::uint32_t>(cellBits), 4);
+    appendInt(content, ircode.size(), 8);
+    appendInt(content, prefixOutput.size(), 8);
+    appendInt(content, sourceOffsets.size(), 8);
+    appendInt(content, hash(reinterpret_cast<const unsigned char*>(payload.data()), payload.size()), 8);
+    return content + payload;
+  }
+
+  /*!
+   * @brief Write IR code to a .bfir file
+   * @param [in] filename       File name
+   * @param [in] ircode         IR code
+   * @param [in] prefixOutput   Output of the prefix executed at compile time
+   * @param [in] cellBits       Width of a cell in bits
+   * @param [in] sourceOffsets  Offset in the source code of each instruction,
+   *                            or empty if they are unknown
+   */
+  static void
+  save(const std::string& filename, const std::vector<BfInst>& ircode, const std::string& prefixOutput, int cellBits,
+      const std::vector<std::uint32_t>& sourceOffsets=std::vector<std::uint32_t>())
+  {
+    std::ofstream ofs(filename.c_str(), std::ios::binary);
+    if (!ofs.is_open()) {
+      throw std::runtime_error("Failed to open: " + filename);
+    }
+    const std::string content = serialize(ircode, prefixOutput, cellBits, sourceOffsets);
+    ofs.write(content.data(), static_cast<std::streamsize>(content.size()));
+    if (!ofs) {
+      throw std::runtime_error("Failed to write: " + filename);
+    }
+  }
+
+  /*!
+   * @brief Get the width of a cell which the IR code is optimized for
+   * @return Width of a cell in bits
+   */
+  int
+  getCellBits() const IR_FILE_NOEXCEPT
+  {
+    return cellBits;
+  }
+
+  /*!
+   * @brief Read the instructions
+   * @param [out] ircode  IR code
+   */
+  void
+  getInstructions(std::vector<BfInst>& ircode) const
+  {
+    ircode.resize(instructionCount);
+    const unsigned char* p = data + kHeaderSize;
+    for (std::size_t i = 0; i < instructionCount; i++, p += kInstructionSize) {
+      ircode[i] = BfInst(
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+          static_cast<BfInst::Type>(readInt(p, 4)),
+#else
+          static_cast<BfInst::Type::TypeEnum>(readInt(p, 4)),
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+          static_cast<std::int32_t>(readInt(p + 4, 4)),
+          static_cast<std::int32_t>(readInt(p + 8, 4)));
+    }
+  }
+
+  /*!
+   * @brief Get the output of the prefix executed at compile time
+   * @return The output of the prefix
+   */
+  std::string
+  getPrefixOutput() const
+  {
+    return std::string(reinterpret_cast<const char*>(data + kHeaderSize + instructionCount * kInstructionSize), prefixSize);
+  }
+
+  /*!
+   * @brief Read the source offsets of the instructions
+   * @param [out] sourceOffsets  Offset in the source code of each
+   *                             instruction, or empty if the file has no
+   *                             table
+   */
+  void
+  getSourceOffsets(std::vector<std::uint32_t>& sourceOffsets) const
+  {
+    sourceOffsets.resize(offsetCount);
+    const unsigned char* p = data + kHeaderSize + instructionCount * kInstructionSize + prefixSize;
+    for (std::size_t i = 0; i < offsetCount; i++, p += 4) {
+      sourceOffsets[i] = static_cast<std::uint32_t>(readInt(p, 4));
+    }
+  }
+
+private:
+  //! Size of the header
+  static const std::size_t kHeaderSize = 48;
+  //! Size of an instruction
+  static const std::size_t kInstructionSize = 12;
+
+  //! Mapped file (NULL if the file is read into buffer)
+  void* mapping;
+  //! Content of the file read without mmap()
+  std::string buffer;
+  //! Content of the file
+  const unsigned char* data;
+  //! Size of the file
+  std::size_t size;
+  //! Width of a cell in bits
+  int cellBits;
+  //! The number of instructions
+  std::size_t instructionCount;
+  //! Size of the output of the prefix
+  std::size_t prefixSize;
+  //! The number of source offsets
+  std::size_t offsetCount;
+
+  /*!
+   * @brief Check the header and the checksum, and read the header
+   * @return True if the file is valid, otherwise false
+   */
+  bool
+  check() IR_FILE_NOEXCEPT
+  {
+    if (size < kHeaderSize || std::memcmp(data, getMagic(), 8) != 0 || readInt(data + 8, 4) != kVersion) {
+      return false;
+    }
+    std::uint64_t bits = readInt(data + 12, 4);
+    if (bits != 8 && bits != 16 && bits != 32 && bits != 64) {
+      return false;
+    }
+    std::uint64_t payloadSize = size - kHeaderSize;
+    std::uint64_t nInstructions = readInt(data + 16, 8);
+    std::uint64_t nPrefixBytes = readInt(data + 24, 8);
+    std::uint64_t nOffsets = readInt(data + 32, 8);
+    if (nInstructions > payloadSize / kInstructionSize
+        || nPrefixBytes > payloadSize - nInstructions * kInstructionSize
+        || (nOffsets != 0 && nOffsets != nInstructions)
+        || nInstructions * kInstructionSize + nPrefixBytes + nOffsets * 4 != payloadSize
+        || readInt(data + 40, 8) != hash(data + kHeaderSize, size - kHeaderSize)) {
+      return false;
+    }
+    for (const unsigned char* p = data + kHeaderSize; p != data + kHeaderSize + nInstructions * kInstructionSize; p += kInstructionSize) {
+      if (readInt(p, 4) >= static_cast<std::uint64_t>(BfInst::Type::kUnknown)) {
+        return false;
+      }
+    }
+    cellBits = static_cast<int>(bits);
+    instructionCount = nInstructions;
+    prefixSize = nPrefixBytes;
+    offsetCount = nOffsets;
+    return true;
+  }
+
+  /*!
+   * @brief Unmap the file
+   */
+  void
+  release() IR_FILE_NOEXCEPT
+  {
+#if !defined(_WIN32)
+    if (mapping != NULL) {
+      munmap(mapping, size);
+      mapping = NULL;
+    }
+#endif  // !defined(_WIN32)
+  }
+
+  /*!
+   * @brief Get the magic number of .bfir files
+   * @return The magic number, whose size is 8 bytes
+   */
+  static const char*
+  getMagic() IR_FILE_NOEXCEPT
+  {
+    return "KBFIR\0\0";
+  }
+
+  /*!
+   * @brief Append a little-endian integer
+   * @param [in,out] s      Destination
+   * @param [in]     value  Integer
+   * @param [in]     n      The number of bytes
+   */
+  static void
+  appendInt(std::string& s, std::uint64_t value, int n)
+  {
+    for (int i = 0; i < n; i++) {
+      s += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+  }
+
+  /*!
+   * @brief Read a little-endian integer
+   * @param [in] p  Pointer to the integer
+   * @param [in] n  The number of bytes
+   * @return The integer
+   */
+  static std::uint64_t
+  readInt(const unsigned char* p, int n) IR_FILE_NOEXCEPT
+  {
+    std::uint64_t value = 0;
+    for (int i = n - 1; i >= 0; i--) {
+      value = (value << 8) | p[i];
+    }
+    return value;
+  }
+
+  /*!
+   * @brief Calculate the FNV-1a hash of bytes
+   * @param [in] p  Bytes
+   * @param [in] n  The number of bytes
+   * @return The hash
+   */
+  static std::uint64_t
+  hash(const unsigned char* p, std::size_t n) IR_FILE_NOEXCEPT
+  {
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    for (std::size_t i = 0; i < n; i++) {
+      h = (h ^ p[i]) * 0x100000001b3ULL;
+    }
+    return h;
+  }
+
+  IRFile(const IRFile&);
+  IRFile&
+  operator=(const IRFile&);
+};  // class IRFile
+
+
+#endif  // IR_FILE_HPP
@@ -0,0 +1,150 @@
+/*!
+ * @file InputReader.hpp
+ * @brief Block reader of standard input
+ * @author koturn
+ */
+#ifndef INPUT_READER_HPP
+#define INPUT_READER_HPP  //!< Include guard
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif  // defined(_MSC_VER) || defined(__MINGW32__)
+
+#if defined(__cplusplus) && __cplusplus >= 201103 \
+  || defined(_MSC_VER) && (_MSC_VER > 1800 || (_MSC_VER == 1800 && _MSC_FULL_VER == 180021114))
+//! Polyfill macro of @code noexcept @endcode
+#  define INPUT_READER_NOEXCEPT  noexcept
+#else
+//! Polyfill macro of @code noexcept @endcode
+#  define INPUT_READER_NOEXCEPT  throw()
+#endif
+
+
+/*!
+ * @class InputReader
+ * @brief Reader of a file descriptor which reads it in large blocks
+ *
+ * A read(2) on a pipe or a file fills the whole buffer, while a read(2) on a
+ * terminal returns as soon as a line is entered.
+ * Use isFlushNeeded() to decide whether pending output must be written
+ * before get(), so that a prompt is shown before the reader blocks.
+ */
+class InputReader
+{
+public:
+  //! Buffer size
+  static const std::size_t kBufferSize = 65536;
+
+  /*!
+   * @brief Get the reader of the standard input
+   *
+   * The reader is shared by all engines, so that the bytes read ahead by one
+   * execution are not lost for the next one.
+   * @return The reader of the standard input
+   */
+  static InputReader&
+  getStdin() INPUT_READER_NOEXCEPT
+  {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    static InputReader reader(_fileno(stdin));
+#else
+    static InputReader reader(fileno(stdin));
+#endif  // defined(_MSC_VER) || defined(__MINGW32__)
+    return reader;
+  }
+
+  /*!
+   * @brief Ctor
+   * @param [in] fd  File descriptor to read
+   */
+  explicit InputReader(int fd) INPUT_READER_NOEXCEPT :
+    fd(fd),
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    isInteractive(_isatty(fd) != 0),
+#else
+    isInteractive(isatty(fd) != 0),
+#endif  // defined(_MSC_VER) || defined(__MINGW32__)
+    isEof(false),
+    pos(0),
+    end(0)
+  {}
+
+  /*!
+   * @brief Check whether pending output should be flushed before get()
+   * @return True if the input is a terminal or the buffer is drained, that is,
+   *         get() may block
+   */
+  bool
+  isFlushNeeded() const INPUT_READER_NOEXCEPT
+  {
+    return isInteractive || pos == end;
+  }
+
+  /*!
+   * @brief Read one byte
+   * @return The byte, or EOF at the end of the input
+   */
+  int
+  get() INPUT_READER_NOEXCEPT
+  {
+    if (pos == end && !fill()) {
+      return EOF;
+    }
+    return buffer[pos++];
+  }
+
+private:
+  //! File descriptor to read
+  int fd;
+  //! True if the file descriptor is a terminal
+  bool isInteractive;
+  //! True if the end of the input has been reached
+  bool isEof;
+  //! Position of the next byte in the buffer
+  std::size_t pos;
+  //! End of the read bytes in the buffer
+  std::size_t end;
+  //! Buffer
+  unsigned char buffer[kBufferSize];
+
+  /*!
+   * @brief Read the next block into the buffer
+   * @return True if at least one byte is read, otherwise false
+   */
+  bool
+  fill() INPUT_READER_NOEXCEPT
+  {
+    if (isEof) {
+      return false;
+    }
+    for (;;) {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+      int n = _read(fd, buffer, static_cast<unsigned int>(kBufferSize));
+#else
+      ssize_t n = read(fd, buffer, kBufferSize);
+#endif  // defined(_MSC_VER) || defined(__MINGW32__)
+      if (n > 0) {
+        pos = 0;
+        end = static_cast<std::size_t>(n);
+        return true;
+      }
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      isEof = true;
+      return false;
+    }
+  }
+
+  InputReader(const InputReader&);
+  InputReader&
+  operator=(const InputReader&);
+};  // class InputReader
+
+
+#endif  // INPUT_READER_HPP
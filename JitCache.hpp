@@ -0,0 +1,352 @@
+/*!
+ * @file JitCache.hpp
+ * @brief On-disk cache of native code of brainfuck programs
+ * @author koturn
+ */
+#ifndef JIT_CACHE_HPP
+#define JIT_CACHE_HPP  //!< Include guard
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+#  include <cstdint>
+#else
+#  include <stdint.h>
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1600
+#if !defined(_WIN32)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+//! Native code can be cached on this platform
+#  define JIT_CACHE_AVAILABLE
+#endif  // !defined(_WIN32)
+
+#if defined(__cplusplus) && __cplusplus >= 201103 \
+  || defined(_MSC_VER) && (_MSC_VER > 1800 || (_MSC_VER == 1800 && _MSC_FULL_VER == 180021114))
+//! Polyfill macro of @code noexcept @endcode
+#  define JIT_CACHE_NOEXCEPT  noexcept
+#else
+//! Polyfill macro of @code noexcept @endcode
+#  define JIT_CACHE_NOEXCEPT  throw()
+#endif
+
+
+/*!
+ * @class JitCache
+ * @brief Native code mapped from a file in a cache directory
+ *
+ * A file holds a key, the output of the prefix of the program executed at
+ * compile time, and position-independent native code.
+ * The key describes everything the native code depends on, and a file whose
+ * key differs from the requested one is rejected as stale.
+ * A file whose output and code do not match the checksum in the header is
+ * rejected as corrupt and removed, so that it is written again.
+ * The file name is a hash of the key.
+ * A file is written to a temporary file and renamed, so that a reader never
+ * sees a partially written file.
+ * The cache is not available on Windows.
+ */
+class JitCache
+{
+public:
+  /*!
+   * @brief Ctor: no code is mapped
+   */
+  JitCache() JIT_CACHE_NOEXCEPT :
+    mapping(NULL),
+    mapSize(0),
+    code(NULL),
+    codeSize(0)
+  {}
+
+  /*!
+   * @brief Dtor: unmap the code
+   */
+  ~JitCache()
+  {
+#if defined(JIT_CACHE_AVAILABLE)
+    if (mapping != NULL) {
+      munmap(mapping, mapSize);
+    }
+#endif  // defined(JIT_CACHE_AVAILABLE)
+  }
+
+  /*!
+   * @brief Map the native code of a key as executable
+   * @param [in]  directory     Cache directory
+   * @param [in]  key           Key of the code
+   * @param [out] prefixOutput  Output of the prefix executed at compile time
+   * @return True if a valid file of the key is found, otherwise false
+   */
+  bool
+  load(const std::string& directory, const std::string& key, std::string& prefixOutput) JIT_CACHE_NOEXCEPT
+  {
+#if defined(JIT_CACHE_AVAILABLE)
+    const std::string path = getPath(directory, key);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Header)) {
+      close(fd);
+      return false;
+    }
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+    void* p = mmap(NULL, size, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      return false;
+    }
+    const unsigned char* base = static_cast<const unsigned char*>(p);
+    Header header;
+    std::memcpy(&header, base, sizeof(header));
+    std::size_t codeOffset = getCodeOffset(header.keySize, header.prefixSize);
+    if (std::memcmp(header.magic, getMagic(), sizeof(header.magic)) != 0
+        || header.keySize != key.size()
+        || header.prefixSize > size
+        || header.codeSize > size
+        || codeOffset + header.codeSize != size
+        || key.compare(0, key.size(), reinterpret_cast<const char*>(base + sizeof(header)), key.size()) != 0) {
+      munmap(p, size);
+      return false;
+    }
+    const unsigned char* prefix = base + sizeof(header) + header.keySize;
+    if (calcChecksum(prefix, header.prefixSize, base + codeOffset, header.codeSize) != header.checksum) {
+      munmap(p, size);
+      unlink(path.c_str());
+      return false;
+    }
+    if (mapping != NULL) {
+      munmap(mapping, mapSize);
+    }
+    mapping = p;
+    mapSize = size;
+    code = base + codeOffset;
+    codeSize = header.codeSize;
+    prefixOutput.assign(reinterpret_cast<const char*>(prefix), header.prefixSize);
+    return true;
+#else
+    static_cast<void>(directory);
+    static_cast<void>(key);
+    static_cast<void>(prefixOutput);
+    return false;
+#endif  // defined(JIT_CACHE_AVAILABLE)
+  }
+
+  /*!
+   * @brief Write native code to the cache directory
+   *
+   * The directory is created if it does not exist.
+   * @param [in] directory     Cache directory
+   * @param [in] key           Key of the code
+   * @param [in] prefixOutput  Output of the prefix executed at compile time
+   * @param [in] data          Position-independent native code
+   * @param [in] size          Size of the native code
+   * @return True if the file is written, otherwise false
+   */
+  static bool
+  store(const std::string& directory, const std::string& key, const std::string& prefixOutput,
+      const void* data, std::size_t size) JIT_CACHE_NOEXCEPT
+  {
+#if defined(JIT_CACHE_AVAILABLE)
+    mkdir(directory.c_str(), 0755);
+    const std::string path = getPath(directory, key);
+    std::ostringstream oss;
+    oss << path << ".tmp" << getpid();
+    const std::string tmpPath = oss.str();
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_EXCL, 0644);
+    if (fd == -1) {
+      return false;
+    }
+    Header header;
+    std::memcpy(header.magic, getMagic(), sizeof(header.magic));
+    header.keySize = key.size();
+    header.prefixSize = prefixOutput.size();
+    header.codeSize = size;
+    header.checksum = calcChecksum(prefixOutput.data(), prefixOutput.size(), data, size);
+    std::size_t paddingSize = getCodeOffset(key.size(), prefixOutput.size()) - sizeof(header) - key.size() - prefixOutput.size();
+    static const char kPadding[kCodeAlignment] = {0};
+    bool isWritten = writeAll(fd, &header, sizeof(header))
+      && writeAll(fd, key.data(), key.size())
+      && writeAll(fd, prefixOutput.data(), prefixOutput.size())
+      && writeAll(fd, kPadding, paddingSize)
+      && writeAll(fd, data, size);
+    if (close(fd) != 0 || !isWritten || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+      unlink(tmpPath.c_str());
+      return false;
+    }
+    return true;
+#else
+    static_cast<void>(directory);
+    static_cast<void>(key);
+    static_cast<void>(prefixOutput);
+    static_cast<void>(data);
+    static_cast<void>(size);
+    return false;
+#endif  // defined(JIT_CACHE_AVAILABLE)
+  }
+
+  /*!
+   * @brief Get the mapped native code
+   * @return The native code, or NULL if no code is mapped
+   */
+  const unsigned char*
+  getCode() const JIT_CACHE_NOEXCEPT
+  {
+    return code;
+  }
+
+  /*!
+   * @brief Get the size of the mapped native code
+   * @return Size of the native code
+   */
+  std::size_t
+  getCodeSize() const JIT_CACHE_NOEXCEPT
+  {
+    return codeSize;
+  }
+
+private:
+  /*!
+   * @brief Header of a cache file, which is followed by the key, the output
+   *        of the prefix, padding and the native code
+   */
+  struct Header
+  {
+    //! Magic number, which is getMagic()
+    char magic[8];
+    //! Size of the key
+    std::size_t keySize;
+    //! Size of the output of the prefix
+    std::size_t prefixSize;
+    //! Size of the native code
+    std::size_t codeSize;
+    //! FNV-1a hash of the output of the prefix and the native code
+    std::uint64_t checksum;
+  };  // struct Header
+
+  //! Alignment of the native code in a cache file
+  static const std::size_t kCodeAlignment = 64;
+
+  //! Mapped file
+  void* mapping;
+  //! Size of the mapped file
+  std::size_t mapSize;
+  //! Native code in the mapped file
+  const unsigned char* code;
+  //! Size of the native code
+  std::size_t codeSize;
+
+  /*!
+   * @brief Get the magic number of a cache file
+   * @return The magic number, which includes the version of the format
+   */
+  static const char*
+  getMagic() JIT_CACHE_NOEXCEPT
+  {
+    return "KBFJIT02";
+  }
+
+  /*!
+   * @brief Get the path of the cache file of a key
+   * @param [in] directory  Cache directory
+   * @param [in] key        Key of the code
+   * @return Path of the file, whose name is the FNV-1a hash of the key
+   */
+  static std::string
+  getPath(const std::string& directory, const std::string& key)
+  {
+    std::uint64_t hash = fnv1a(key.data(), key.size(), 0xcbf29ce484222325ULL);
+    std::ostringstream oss;
+    oss << directory << '/' << std::hex;
+    oss.width(16);
+    oss.fill('0');
+    oss << hash << ".jit";
+    return oss.str();
+  }
+
+  /*!
+   * @brief Calculate the checksum of the payload of a cache file
+   * @param [in] prefix      Output of the prefix
+   * @param [in] prefixSize  Size of the output of the prefix
+   * @param [in] code        Native code
+   * @param [in] codeSize    Size of the native code
+   * @return FNV-1a hash of the output of the prefix followed by the code
+   */
+  static std::uint64_t
+  calcChecksum(const void* prefix, std::size_t prefixSize, const void* code, std::size_t codeSize) JIT_CACHE_NOEXCEPT
+  {
+    return fnv1a(code, codeSize, fnv1a(prefix, prefixSize, 0xcbf29ce484222325ULL));
+  }
+
+  /*!
+   * @brief Update an FNV-1a hash with bytes
+   * @param [in] data  Bytes
+   * @param [in] size  The number of bytes
+   * @param [in] hash  Hash of the preceding bytes
+   * @return Updated hash
+   */
+  static std::uint64_t
+  fnv1a(const void* data, std::size_t size, std::uint64_t hash) JIT_CACHE_NOEXCEPT
+  {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; i++) {
+      hash = (hash ^ p[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+  }
+
+  /*!
+   * @brief Get the offset of the native code in a cache file
+   * @param [in] keySize     Size of the key
+   * @param [in] prefixSize  Size of the output of the prefix
+   * @return Offset of the native code
+   */
+  static std::size_t
+  getCodeOffset(std::size_t keySize, std::size_t prefixSize) JIT_CACHE_NOEXCEPT
+  {
+    std::size_t offset = sizeof(Header) + keySize + prefixSize;
+    return (offset + kCodeAlignment - 1) / kCodeAlignment * kCodeAlignment;
+  }
+
+#if defined(JIT_CACHE_AVAILABLE)
+  /*!
+   * @brief Write all bytes to a file descriptor
+   * @param [in] fd    File descriptor
+   * @param [in] data  Bytes to write
+   * @param [in] size  The number of bytes
+   * @return True if all bytes are written, otherwise false
+   */
+  static bool
+  writeAll(int fd, const void* data, std::size_t size) JIT_CACHE_NOEXCEPT
+  {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    while (p != end) {
+      ssize_t n = write(fd, p, static_cast<std::size_t>(end - p));
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return false;
+      }
+      p += n;
+    }
+    return true;
+  }
+#endif  // defined(JIT_CACHE_AVAILABLE)
+
+  JitCache(const JitCache&);
+  JitCache&
+  operator=(const JitCache&);
+};  // class JitCache
+
+
+
+#endif  // JIT_CACHE_HPP
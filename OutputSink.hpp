@@ -0,0 +1,283 @@
+/*!
+ * @file OutputSink.hpp
+ * @brief Buffered output of brainfuck programs
+ * @author koturn
+ */
+#ifndef OUTPUT_SINK_HPP
+#define OUTPUT_SINK_HPP  //!< Include guard
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif  // defined(_MSC_VER) || defined(__MINGW32__)
+
+#if defined(__cplusplus) && __cplusplus >= 201103 \
+  || defined(_MSC_VER) && (_MSC_VER > 1800 || (_MSC_VER == 1800 && _MSC_FULL_VER == 180021114))
+//! Polyfill macro of @code noexcept @endcode
+#  define OUTPUT_SINK_NOEXCEPT  noexcept
+#else
+//! Polyfill macro of @code noexcept @endcode
+#  define OUTPUT_SINK_NOEXCEPT  throw()
+#endif
+
+
+/*!
+ * @class OutputSink
+ * @brief Fixed-size output buffer which all engines write into
+ *
+ * The buffered bytes go to a file descriptor, or are appended to a
+ * std::string to capture the output in memory.
+ * The buffer is always flushed when it is full, and when flush() is called at
+ * the end of an execution; FlushPolicy adds other points.
+ */
+class OutputSink
+{
+public:
+#if __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+  /*!
+   * @brief When the buffer is flushed besides when it is full
+   */
+  enum class FlushPolicy
+  {
+    //! Only at the end of an execution
+    kExit,
+    //! At every newline, and before input which may block
+    kLine,
+    //! Before input which may block
+    kInput,
+    //! When the given number of bytes are buffered, and before input which
+    //! may block
+    kBytes
+  };  // enum class FlushPolicy
+#else
+  /*!
+   * @brief When the buffer is flushed besides when it is full
+   */
+  class FlushPolicy
+  {
+  public:
+    /*!
+     * @brief Actual enum of flush policy
+     */
+    enum FlushPolicyEnum
+    {
+      kExit, kLine, kInput, kBytes
+    };
+    /*!
+     * @brief Ctor for implicit conversion: Actual enum to dummy enum class
+     * @param [in] value  Actual enum value
+     */
+    FlushPolicy(FlushPolicyEnum value) :
+      value(value)
+    {}
+    /*!
+     * @brief operator () for implicit conversion: Dummy enum class to actual
+     *        enum
+     * @return Actual enum value
+     */
+    operator FlushPolicyEnum() const throw()
+    {
+      return value;
+    }
+  private:
+    //! Actual enum value
+    FlushPolicyEnum value;
+  };  // class FlushPolicy
+#endif  // __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+
+  //! Buffer size
+  static const std::size_t kBufferSize = 65536;
+
+  /*!
+   * @brief Get the sink of the standard output
+   * @return The sink of the standard output
+   */
+  static OutputSink&
+  getStdout() OUTPUT_SINK_NOEXCEPT
+  {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    static OutputSink sink(_fileno(stdout));
+#else
+    static OutputSink sink(fileno(stdout));
+#endif  // defined(_MSC_VER) || defined(__MINGW32__)
+    return sink;
+  }
+
+  /*!
+   * @brief Ctor: write to a file descriptor
+   * @param [in] fd  File descriptor to write
+   */
+  explicit OutputSink(int fd) OUTPUT_SINK_NOEXCEPT :
+    fd(fd),
+    capture(NULL),
+    policy(FlushPolicy::kInput),
+    limit(kBufferSize),
+    pos(0)
+  {}
+
+  /*!
+   * @brief Ctor: append to a string
+   * @param [out] capture  String which the output is appended to
+   */
+  explicit OutputSink(std::string& capture) OUTPUT_SINK_NOEXCEPT :
+    fd(-1),
+    capture(&capture),
+    policy(FlushPolicy::kExit),
+    limit(kBufferSize),
+    pos(0)
+  {}
+
+  /*!
+   * @brief Dtor: flush the buffer
+   */
+  ~OutputSink()
+  {
+    flush();
+  }
+
+  /*!
+   * @brief Set flush policy
+   * @param [in] policy_  Flush policy
+   * @param [in] nBytes   Number of bytes which causes flush with
+   *                      FlushPolicy::kBytes (clamped to [1, kBufferSize])
+   */
+  void
+  setFlushPolicy(FlushPolicy policy_, std::size_t nBytes=kBufferSize) OUTPUT_SINK_NOEXCEPT
+  {
+    flush();
+    policy = policy_;
+    limit = policy == FlushPolicy::kBytes && nBytes < kBufferSize ? (nBytes == 0 ? 1 : nBytes) : kBufferSize;
+  }
+
+  /*!
+   * @brief Get flush policy
+   * @return Flush policy
+   */
+  FlushPolicy
+  getFlushPolicy() const OUTPUT_SINK_NOEXCEPT
+  {
+    return policy;
+  }
+
+  /*!
+   * @brief Get the number of bytes which causes flush
+   * @return kBufferSize, or the number of bytes given with FlushPolicy::kBytes
+   */
+  std::size_t
+  getFlushBytes() const OUTPUT_SINK_NOEXCEPT
+  {
+    return limit;
+  }
+
+  /*!
+   * @brief Write one byte
+   * @param [in] c  Byte to write
+   */
+  void
+  put(unsigned char c) OUTPUT_SINK_NOEXCEPT
+  {
+    buffer[pos++] = c;
+    if (pos == limit || (c == '\n' && policy == FlushPolicy::kLine)) {
+      flush();
+    }
+  }
+
+  /*!
+   * @brief Write bytes
+   * @param [in] data  Bytes to write
+   * @param [in] size  The number of bytes
+   */
+  void
+  write(const void* data, std::size_t size) OUTPUT_SINK_NOEXCEPT
+  {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    while (p != end) {
+      std::size_t n = std::min(static_cast<std::size_t>(end - p), limit - pos);
+      std::memcpy(buffer + pos, p, n);
+      pos += n;
+      p += n;
+      if (pos == limit) {
+        flush();
+      }
+    }
+    if (policy == FlushPolicy::kLine && std::memchr(data, '\n', size) != NULL) {
+      flush();
+    }
+  }
+
+  /*!
+   * @brief Flush the buffer before input unless the policy is
+   *        FlushPolicy::kExit
+   * @param [in] mayBlock  True if the input may block
+   */
+  void
+  flushBeforeInput(bool mayBlock) OUTPUT_SINK_NOEXCEPT
+  {
+    if (mayBlock && policy != FlushPolicy::kExit) {
+      flush();
+    }
+  }
+
+  /*!
+   * @brief Write out the buffered bytes
+   */
+  void
+  flush() OUTPUT_SINK_NOEXCEPT
+  {
+    if (pos == 0) {
+      return;
+    }
+    if (capture != NULL) {
+      capture->append(reinterpret_cast<const char*>(buffer), pos);
+      pos = 0;
+      return;
+    }
+    const unsigned char* p = buffer;
+    const unsigned char* end = buffer + pos;
+    while (p != end) {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+      int n = _write(fd, p, static_cast<unsigned int>(end - p));
+#else
+      ssize_t n = ::write(fd, p, static_cast<std::size_t>(end - p));
+#endif  // defined(_MSC_VER) || defined(__MINGW32__)
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        break;
+      }
+      p += n;
+    }
+    pos = 0;
+  }
+
+private:
+  //! File descriptor to write (-1 if the output is captured)
+  int fd;
+  //! String which the output is appended to (NULL if the output is written
+  //! to fd)
+  std::string* capture;
+  //! Flush policy
+  FlushPolicy policy;
+  //! The number of bytes which causes flush
+  std::size_t limit;
+  //! The number of buffered bytes
+  std::size_t pos;
+  //! Buffer
+  unsigned char buffer[kBufferSize];
+
+  OutputSink(const OutputSink&);
+  OutputSink&
+  operator=(const OutputSink&);
+};  // class OutputSink
+
+
+#endif  // OUTPUT_SINK_HPP
@@ -0,0 +1,344 @@
+/*!
+ * @file Tape.hpp
+ * @brief Lazily committed tape of brainfuck programs
+ * @author koturn
+ */
+#ifndef TAPE_HPP
+#define TAPE_HPP  //!< Include guard
+
+#include <cstddef>
+#include <new>
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <setjmp.h>
+#  include <signal.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+//! Tape overflow is detected with guard pages and a signal handler
+#  define TAPE_OVERFLOW_CHECK_AVAILABLE
+#endif  // defined(_WIN32)
+
+#include "HugePages.hpp"
+
+#if defined(__cplusplus) && __cplusplus >= 201103 \
+  || defined(_MSC_VER) && (_MSC_VER > 1800 || (_MSC_VER == 1800 && _MSC_FULL_VER == 180021114))
+//! Polyfill macro of @code noexcept @endcode
+#  define TAPE_NOEXCEPT  noexcept
+#else
+//! Polyfill macro of @code noexcept @endcode
+#  define TAPE_NOEXCEPT  throw()
+#endif
+
+
+/*!
+ * @class Tape
+ * @brief Zero-filled cells in a reserved virtual address range
+ *
+ * The cells are surrounded by guard regions, and only kInitialCommitSize
+ * bytes around the first cell are accessible at first.
+ * An access out of the tape is detected only if it hits a guard region, so
+ * the guard regions must be at least as large as the distance of the pointer
+ * between two accesses.
+ * A bidirectional tape has as many cells before the first cell as after it,
+ * so negative indices are valid.
+ * A tape backed by huge pages is committed in units of HugePages::kSize.
+ * An access to an inaccessible cell is caught by a SIGSEGV handler, which
+ * makes more cells accessible, or jumps to getOverflowJumpBuffer() if the
+ * access is out of the tape.
+ * Call sigsetjmp() with getOverflowJumpBuffer() before executing a program.
+ * On Windows, all the cells are committed at once on normal pages and
+ * overflow is not detected.
+ */
+class Tape
+{
+public:
+#if defined(TAPE_OVERFLOW_CHECK_AVAILABLE)
+  //! Function which is called with the signal context and an argument on
+  //! overflow
+  typedef void (*OverflowHandler)(void* context, void* arg);
+#endif  // defined(TAPE_OVERFLOW_CHECK_AVAILABLE)
+
+  //! Size of the region which is made accessible at first
+  static const std::size_t kInitialCommitSize = 65536;
+  //! Minimum size of the guard regions before and after the cells
+  static const std::size_t kGuardSize = 65536;
+
+  /*!
+   * @brief Ctor
+   * @param [in] size             The number of cells from the first cell
+   * @param [in] isBidirectional  Also reserve size cells before the first cell
+   * @param [in] useHugePages     Back the cells with huge pages if available
+   * @param [in] guardSize        Size of the guard regions, which is rounded up
+   *                              to kGuardSize and the page size
+   */
+  explicit Tape(std::size_t size, bool isBidirectional=false, bool useHugePages=false, std::size_t guardSize=kGuardSize) :
+    base(NULL),
+    cells(NULL),
+    granularity(0),
+    capacity(0),
+    lowerCapacity(0),
+    committed(0),
+    lowerCommitted(0),
+    reservedSize(0)
+#if defined(TAPE_OVERFLOW_CHECK_AVAILABLE)
+    ,
+    overflowOffset(0),
+    overflowHandler(NULL),
+    overflowHandlerArg(NULL),
+    previous(NULL),
+    oldSegvAction(),
+    oldBusAction()
+#endif  // defined(TAPE_OVERFLOW_CHECK_AVAILABLE)
+  {
+#if defined(_WIN32)
+    static_cast<void>(useHugePages);
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    granularity = si.dwPageSize;
+    guardSize = alignUp(guardSize < kGuardSize ? kGuardSize : guardSize, granularity);
+    capacity = alignUp(size == 0 ? 1 : size, granularity);
+    lowerCapacity = isBidirectional ? capacity : 0;
+    reservedSize = guardSize + lowerCapacity + capacity + guardSize;
+    base = static_cast<unsigned char*>(VirtualAlloc(NULL, reservedSize, MEM_RESERVE, PAGE_NOACCESS));
+    if (base == NULL) {
+      throw std::bad_alloc();
+    }
+    cells = base + guardSize + lowerCapacity;
+    if (VirtualAlloc(cells - lowerCapacity, lowerCapacity + capacity, MEM_COMMIT, PAGE_READWRITE) == NULL) {
+      VirtualFree(base, 0, MEM_RELEASE);
+      throw std::bad_alloc();
+    }
+    committed = capacity;
+    lowerCommitted = lowerCapacity;
+#else
+    granularity = useHugePages ? HugePages::kSize : static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    guardSize = alignUp(guardSize < kGuardSize ? kGuardSize : guardSize, granularity);
+    capacity = alignUp(size == 0 ? 1 : size, granularity);
+    lowerCapacity = isBidirectional ? capacity : 0;
+    reservedSize = guardSize + lowerCapacity + capacity + guardSize;
+    void* p = useHugePages ? HugePages::map(reservedSize, PROT_NONE) : NULL;
+    if (p == NULL) {
+      p = mmap(NULL, reservedSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+      }
+    }
+    base = static_cast<unsigned char*>(p);
+    cells = base + guardSize + lowerCapacity;
+    if (!commit(alignUp(lowerCapacity < kInitialCommitSize ? lowerCapacity : kInitialCommitSize, granularity),
+          alignUp(capacity < kInitialCommitSize ? capacity : kInitialCommitSize, granularity))) {
+      munmap(base, reservedSize);
+      throw std::bad_alloc();
+    }
+    struct sigaction sa;
+    sa.sa_sigaction = onFault;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_SIGINFO;
+    sigaction(SIGSEGV, &sa, &oldSegvAction);
+    sigaction(SIGBUS, &sa, &oldBusAction);
+    previous = getActive();
+    getActive() = this;
+#endif  // defined(_WIN32)
+  }
+
+  /*!
+   * @brief Dtor: release the cells and restore the signal handlers
+   */
+  ~Tape()
+  {
+#if defined(_WIN32)
+    VirtualFree(base, 0, MEM_RELEASE);
+#else
+    getActive() = previous;
+    sigaction(SIGSEGV, &oldSegvAction, NULL);
+    sigaction(SIGBUS, &oldBusAction, NULL);
+    munmap(base, reservedSize);
+#endif  // defined(_WIN32)
+  }
+
+  /*!
+   * @brief Get the first cell
+   * @return Pointer to the first cell
+   */
+  unsigned char*
+  get() const TAPE_NOEXCEPT
+  {
+    return cells;
+  }
+
+#if defined(TAPE_OVERFLOW_CHECK_AVAILABLE)
+  /*!
+   * @brief Get the jump buffer which the signal handler jumps to on overflow
+   * @return Jump buffer for sigsetjmp()
+   */
+  sigjmp_buf&
+  getOverflowJumpBuffer() TAPE_NOEXCEPT
+  {
+    return overflowJump;
+  }
+
+  /*!
+   * @brief Get the offset of the cell whose access caused overflow
+   * @return Offset from the first cell
+   */
+  std::ptrdiff_t
+  getOverflowOffset() const TAPE_NOEXCEPT
+  {
+    return overflowOffset;
+  }
+
+  /*!
+   * @brief Set a function which the signal handler calls on overflow before
+   *        jumping to getOverflowJumpBuffer()
+   *
+   * The function gets the ucontext_t of the faulting access, so that it can
+   * save the state of the code which was running.
+   * It must be async-signal-safe.
+   * @param [in] handler  Function, or NULL to call no function
+   * @param [in] arg      Argument passed to the function
+   */
+  void
+  setOverflowHandler(OverflowHandler handler, void* arg) TAPE_NOEXCEPT
+  {
+    overflowHandler = handler;
+    overflowHandlerArg = arg;
+  }
+#endif  // defined(TAPE_OVERFLOW_CHECK_AVAILABLE)
+
+private:
+  //! Start of the reserved range
+  unsigned char* base;
+  //! First cell
+  unsigned char* cells;
+  //! Unit of commit
+  std::size_t granularity;
+  //! The number of cells from the first cell, aligned to the page size
+  std::size_t capacity;
+  //! The number of cells before the first cell
+  std::size_t lowerCapacity;
+  //! The number of accessible cells from the first cell
+  std::size_t committed;
+  //! The number of accessible cells before the first cell
+  std::size_t lowerCommitted;
+  //! Size of the reserved range
+  std::size_t reservedSize;
+#if defined(TAPE_OVERFLOW_CHECK_AVAILABLE)
+  //! Offset of the cell whose access caused overflow
+  std::ptrdiff_t overflowOffset;
+  //! Function called on overflow
+  OverflowHandler overflowHandler;
+  //! Argument of overflowHandler
+  void* overflowHandlerArg;
+  //! Tape which was active before this tape
+  Tape* previous;
+  //! Jump buffer which the signal handler jumps to on overflow
+  sigjmp_buf overflowJump;
+  //! SIGSEGV handler before this tape
+  struct sigaction oldSegvAction;
+  //! SIGBUS handler before this tape
+  struct sigaction oldBusAction;
+
+  /*!
+   * @brief Get the tape which the signal handler grows
+   * @return Reference to the pointer to the active tape
+   */
+  static Tape*&
+  getActive() TAPE_NOEXCEPT
+  {
+    static Tape* active = NULL;
+    return active;
+  }
+
+  /*!
+   * @brief Make more cells accessible
+   * @param [in] lowerSize  The number of cells before the first cell which
+   *                        should be accessible
+   * @param [in] size       The number of cells from the first cell which
+   *                        should be accessible
+   * @return True if the cells are made accessible, otherwise false
+   */
+  bool
+  commit(std::size_t lowerSize, std::size_t size) TAPE_NOEXCEPT
+  {
+    if (mprotect(cells - lowerSize, lowerSize + size, PROT_READ | PROT_WRITE) != 0) {
+      return false;
+    }
+    lowerCommitted = lowerSize;
+    committed = size;
+    return true;
+  }
+
+  /*!
+   * @brief Calculate the number of cells to commit in one direction
+   * @param [in] current   The number of accessible cells
+   * @param [in] required  The number of cells which must be accessible
+   * @param [in] limit     The number of reserved cells
+   * @return Twice of current or required, whichever is larger, which is
+   *         aligned to granularity and limited to limit
+   */
+  std::size_t
+  calcCommitSize(std::size_t current, std::size_t required, std::size_t limit) const TAPE_NOEXCEPT
+  {
+    std::size_t size = current * 2 > required ? current * 2 : required;
+    return alignUp(size < limit ? size : limit, granularity);
+  }
+
+  /*!
+   * @brief Handler of SIGSEGV and SIGBUS
+   *
+   * An access to an uncommitted cell doubles the accessible cells in its
+   * direction, and an access to a guard region jumps to the overflow handler.
+   * Other faults are passed to the previous handler.
+   * @param [in] sig      Signal number
+   * @param [in] info     Information of the signal
+   * @param [in] context  Context of the faulting access, which is passed to
+   *                      the overflow handler
+   */
+  static void
+  onFault(int sig, siginfo_t* info, void* context) TAPE_NOEXCEPT
+  {
+    Tape* tape = getActive();
+    unsigned char* addr = static_cast<unsigned char*>(info->si_addr);
+    if (tape->base <= addr && addr < tape->base + tape->reservedSize) {
+      std::ptrdiff_t offset = addr - tape->cells;
+      if (offset >= 0 && tape->committed <= static_cast<std::size_t>(offset) && static_cast<std::size_t>(offset) < tape->capacity) {
+        if (tape->commit(tape->lowerCommitted, tape->calcCommitSize(tape->committed, static_cast<std::size_t>(offset) + 1, tape->capacity))) {
+          return;
+        }
+      } else if (offset < 0 && tape->lowerCommitted < static_cast<std::size_t>(-offset) && static_cast<std::size_t>(-offset) <= tape->lowerCapacity) {
+        if (tape->commit(tape->calcCommitSize(tape->lowerCommitted, static_cast<std::size_t>(-offset), tape->lowerCapacity), tape->committed)) {
+          return;
+        }
+      }
+      tape->overflowOffset = offset;
+      if (tape->overflowHandler != NULL) {
+        tape->overflowHandler(context, tape->overflowHandlerArg);
+      }
+      siglongjmp(tape->overflowJump, 1);
+    }
+    // Restore the previous handler, which handles the fault when the faulting
+    // instruction is executed again
+    sigaction(sig, sig == SIGSEGV ? &tape->oldSegvAction : &tape->oldBusAction, NULL);
+  }
+#endif  // defined(TAPE_OVERFLOW_CHECK_AVAILABLE)
+
+  /*!
+   * @brief Round up a size to a multiple of an alignment
+   * @param [in] size       Size
+   * @param [in] alignment  Alignment
+   * @return Aligned size
+   */
+  static std::size_t
+  alignUp(std::size_t size, std::size_t alignment) TAPE_NOEXCEPT
+  {
+    return (size + alignment - 1) / alignment * alignment;
+  }
+
+  Tape(const Tape&);
+  Tape&
+  operator=(const Tape&);
+};  // class Tape
+
+
+#endif  // TAPE_HPP
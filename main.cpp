@@ -1,4 +1,6 @@
+#include <cstdio>
 #include <cstdlib>
+#include <algorithm>
 #include <exception>
 #include <fstream>
 #include <iostream>
@@ -8,6 +10,11 @@
 #else
 #  include <map>
 #endif  //  __cplusplus >= 201103L || defined(_MSC_VER) && _MSC_VER >= 1700
+#ifdef _MSC_VER
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif  // _MSC_VER
 
 #include "ArgumentParser.hpp"
 #include "Brainfuck.hpp"
@@ -37,6 +44,9 @@ removeDirectoryPart(const std::string& filepath) NOEXCEPT;
 static std::string
 removeSuffix(const std::string& filename) NOEXCEPT;
 
+static bool
+isStdoutTerminal() NOEXCEPT;
+
 
 int
 main(int argc, const char* argv[])
@@ -87,12 +97,51 @@ main(int argc, const char* argv[])
         + "- 0: Execute directly" + ap.getNewlineDescription()
         + "- 1: Compile to IR code and execute" + ap.getNewlineDescription()
         + "- 2: Compile to native code and execute", "LEVEL", 1);
+    ap.add("dispatch", ArgumentParser::OptionType::kRequiredArgument,
+        "Specify dispatch method of IR code interpreter (-O1)" + ap.getNewlineDescription()
+        + "Default value: switch" + ap.getNewlineDescription()
+        + "- switch:   Dispatch with switch statement" + ap.getNewlineDescription()
+        + "- threaded: Dispatch with threaded code" + ap.getNewlineDescription()
+        + "- packed:   Dispatch packed IR code", "DISPATCH", "switch");
     ap.add("dump-ir", "Dump IR code");
+    ap.add("dump-ir-size", "Dump byte size of IR code and packed IR code");
+    ap.add("emit-ir", ArgumentParser::OptionType::kRequiredArgument,
+        "Write optimized IR code to a binary IR file and exit", "FILE", "");
     ap.add("enable-synchronize-with-stdio", "Disable synchronization between std::cout/std::cin and <cstdio>");
+    ap.add("flush", ArgumentParser::OptionType::kRequiredArgument,
+        "Specify when the output buffer is flushed besides when it is full" + ap.getNewlineDescription()
+        + "Default value: input" + ap.getNewlineDescription()
+        + "- exit:    Only at exit" + ap.getNewlineDescription()
+        + "- line:    At every newline, and before input which may block" + ap.getNewlineDescription()
+        + "- input:   Before input which may block" + ap.getNewlineDescription()
+        + "- bytes:N: Every N bytes, and before input which may block", "POLICY", "input");
+    ap.add("cell-size", ArgumentParser::OptionType::kRequiredArgument,
+        "Specify cell size in bits: 8, 16, 32 or 64" + ap.getNewlineDescription()
+        + "Default value: 8", "BITS", 8);
     ap.add("heap-size", ArgumentParser::OptionType::kRequiredArgument,
-        "Specify heap memory size" + ap.getNewlineDescription()
+        "Specify heap size in cells" + ap.getNewlineDescription()
         + "Default value: 65536", "HEAP_SIZE", 65536);
+    ap.add("ir", ArgumentParser::OptionType::kRequiredArgument,
+        "Load optimized IR code from a binary IR file written by --emit-ir" + ap.getNewlineDescription()
+        + "instead of brainfuck source code", "FILE", "");
+    ap.add("jit-cache", ArgumentParser::OptionType::kRequiredArgument,
+        "Specify directory of the cache of native code (-O2)", "DIR", "");
+    ap.add("partial-eval-steps", ArgumentParser::OptionType::kRequiredArgument,
+        "Specify step budget of compile-time execution of the program" + ap.getNewlineDescription()
+        + "until the first input (0 disables it)" + ap.getNewlineDescription()
+        + "Default value: 1000000", "STEPS", 1000000);
+    ap.add("partial-eval-memory", ArgumentParser::OptionType::kRequiredArgument,
+        "Specify memory budget of compile-time execution of the program" + ap.getNewlineDescription()
+        + "Default value: 65536", "CELLS", 65536);
+    ap.add("bidirectional-tape", "Start the pointer in the middle of the heap to allow cells at" + ap.getNewlineDescription()
+        + "negative indices");
+    ap.add("huge-pages", "Back the heap and the JIT code buffer with huge pages if available");
+    ap.add("profile", "Count executions of IR instructions and report hot spots" + ap.getNewlineDescription()
+        + "to stderr (-O1, --dispatch=switch)");
+    ap.add("tiered", "Interpret IR code first and compile hot loops to native code (-O2)");
     ap.add("top-break-point", "Add break point to the top of code");
+    ap.add("tty-line-buffering", "Flush the output at every newline when stdout is a terminal" + ap.getNewlineDescription()
+        + "(same as --flush=line)");
     ap.parse(argc, argv);
 
     if (ap.get<bool>("help")) {
@@ -114,13 +163,58 @@ main(int argc, const char* argv[])
     }
     std::size_t heapSize = ap.get<std::size_t>("heap-size");
     int optLevel = ap.get<int>("optimize");
+    const std::string& dispatch = ap.get("dispatch");
+    if (dispatch != "switch" && dispatch != "threaded" && dispatch != "packed") {
+      std::cerr << "Option --dispatch: Invalid value: \"" << dispatch << "\" is specified" << std::endl;
+      return EXIT_FAILURE;
+    }
+    bool isProfiled = ap.get<bool>("profile");
+    if (isProfiled && (optLevel != 1 || dispatch != "switch")) {
+      std::cerr << "Option --profile: Only available with -O1 and --dispatch=switch" << std::endl;
+      return EXIT_FAILURE;
+    }
+    int cellSize = ap.get<int>("cell-size");
+    if (cellSize != 8 && cellSize != 16 && cellSize != 32 && cellSize != 64) {
+      std::cerr << "Option --cell-size: Invalid value: \"" << cellSize << "\" is specified" << std::endl;
+      return EXIT_FAILURE;
+    }
+    const std::string& flush = ap.get("flush");
+    OutputSink& sink = OutputSink::getStdout();
+    if (flush == "exit") {
+      sink.setFlushPolicy(OutputSink::FlushPolicy::kExit);
+    } else if (flush == "line") {
+      sink.setFlushPolicy(OutputSink::FlushPolicy::kLine);
+    } else if (flush == "input") {
+      sink.setFlushPolicy(OutputSink::FlushPolicy::kInput);
+    } else if (flush.compare(0, 6, "bytes:") == 0
+        && flush.find_first_not_of("0123456789", 6) == std::string::npos
+        && std::strtoul(flush.c_str() + 6, NULL, 10) > 0) {
+      sink.setFlushPolicy(OutputSink::FlushPolicy::kBytes, std::strtoul(flush.c_str() + 6, NULL, 10));
+    } else {
+      std::cerr << "Option --flush: Invalid value: \"" << flush << "\" is specified" << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (ap.get<bool>("tty-line-buffering") && isStdoutTerminal()) {
+      sink.setFlushPolicy(OutputSink::FlushPolicy::kLine);
+    }
 
     const std::vector<std::string>& args = ap.getArguments();
     const std::string& source = ap.get("eval");
+    const std::string& irFile = ap.get("ir");
     std::string inputFile = "a.b";
 
-    Brainfuck bf;
-    if (source != "") {
+    Brainfuck bf(ap.get<bool>("huge-pages"));
+    bf.setBidirectionalTape(ap.get<bool>("bidirectional-tape"));
+    bf.setCellBits(cellSize);
+    bf.setEvalLimit(
+        ap.get<std::size_t>("partial-eval-steps"),
+        std::min(ap.get<std::size_t>("partial-eval-memory"), heapSize));
+    if (irFile != "") {
+      bf.loadIR(irFile);
+      inputFile = irFile;
+      // The IR code is optimized for the cell size in the file
+      cellSize = bf.getCellBits();
+    } else if (source != "") {
       bf.loadSource(source);
     } else if (args.size() > 0) {
       if (args[0] == "-") {
@@ -147,14 +241,33 @@ main(int argc, const char* argv[])
       bf.dumpIR();
       return EXIT_SUCCESS;
     }
+    if (ap.get<bool>("dump-ir-size")) {
+      bf.compile(Brainfuck::CompileType::kIR, hasTopBreakPoint);
+      bf.compileToPackedIR();
+      bf.dumpIRSize();
+      return EXIT_SUCCESS;
+    }
+    const std::string& emitIRFile = ap.get("emit-ir");
+    if (emitIRFile != "") {
+      bf.compile(Brainfuck::CompileType::kIR, hasTopBreakPoint);
+      bf.saveIR(emitIRFile);
+      return EXIT_SUCCESS;
+    }
     const std::string& target = ap.get("target");
     if (target != "") {
       if (targetMap.find(target) == targetMap.end()) {
         std::cerr << "Option -t, --target: Invalid value: \"" << target << "\" is specified" << std::endl;
         return EXIT_FAILURE;
       }
-      bf.compile(Brainfuck::CompileType::kJit, hasTopBreakPoint);
       Brainfuck::Target targetType = targetMap[target];
+      if ((cellSize != 8 && (targetType == Brainfuck::Target::kWinX86 || targetType == Brainfuck::Target::kWinX64
+              || targetType == Brainfuck::Target::kElfArmeabi))
+          || (cellSize == 64 && targetType == Brainfuck::Target::kElfX86)) {
+        std::cerr << "Option --cell-size: " << cellSize << "-bit cells are not supported by target: "
+                  << target << std::endl;
+        return EXIT_FAILURE;
+      }
+      bf.compile(Brainfuck::CompileType::kJit, hasTopBreakPoint);
       std::string outputFile = ap.get("output");
       if (outputFile == "") {
         outputFile = getDefaultOutputName(inputFile, targetType);
@@ -192,13 +305,36 @@ main(int argc, const char* argv[])
     }
 
     if (optLevel == 1) {
+      if (dispatch == "threaded") {
+        bf.setDispatchType(Brainfuck::DispatchType::kThreaded);
+      } else if (dispatch == "packed") {
+        bf.setDispatchType(Brainfuck::DispatchType::kPacked);
+      }
+      bf.setProfile(isProfiled);
       bf.compile(Brainfuck::CompileType::kIR, hasTopBreakPoint);
+    } else if (optLevel > 1 && ap.get<bool>("tiered")) {
+      bf.compile(Brainfuck::CompileType::kTiered, hasTopBreakPoint);
     } else if (optLevel > 1) {
+      // Code compiled by another build is not used
+      bf.setJitCache(ap.get("jit-cache"), std::string(kVersion) + " " + __DATE__ + " " + __TIME__);
       bf.compile(Brainfuck::CompileType::kJit, hasTopBreakPoint);
     }
-    bf.execute(heapSize);
+    try {
+      bf.execute(heapSize);
+    } catch (const std::exception& e) {
+      // Report the counts up to the error, which tell where the program went wrong
+      std::cerr << e.what() << std::endl;
+      if (isProfiled) {
+        bf.dumpProfile(std::cerr);
+      }
+      return EXIT_FAILURE;
+    }
+    if (isProfiled) {
+      bf.dumpProfile(std::cerr);
+    }
   } catch (const std::exception& e) {
     std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
   }
   return EXIT_SUCCESS;
 }
@@ -256,3 +392,14 @@ removeSuffix(const std::string& filename) NOEXCEPT
   std::string::size_type pos = filename.find_last_of('.');
   return pos == std::string::npos ? (filename + ".") : filename.substr(0, pos);
 }
+
+
+static bool
+isStdoutTerminal() NOEXCEPT
+{
+#ifdef _MSC_VER
+  return _isatty(_fileno(stdout)) != 0;
+#else
+  return isatty(fileno(stdout)) != 0;
+#endif  // _MSC_VER
+}
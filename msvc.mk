@@ -48,6 +48,12 @@ MAIN_OBJ  = $(MAIN_SRC:.cpp=.obj)
 VERSION_H = version.h
 HEADERS   = BfInst.h \
     ArgumentParser.hpp \
+    InputReader.hpp \
+    HugePages.hpp \
+    IRFile.hpp \
+    JitCache.hpp \
+    OutputSink.hpp \
+    Tape.hpp \
     Brainfuck.hpp \
     CodeGenerator/CodeGenerator.hpp \
     CodeGenerator/SourceGenerator.hpp \
@@ -0,0 +1,22 @@
+Write letters left of the first cell and print them
+
+Read a newline so that the rest is not executed at compile time
+,--
+Cells minus 1 to minus 3 are set to 64 by a loop with negative offsets
+[-<++++++++<++++++++<++++++++>>>]
+<+<++<+++
+Search the zero cell left of the letters and print them from left to right
+[<]>[.>]
+++++++++++.[-]
+
+Mark 80 cells from minus 90 to minus 11 and search the zero cell right of them
+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
++>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>
++>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>+>
+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+[>]
+Write D in cell minus 10 and print it
+>++++++++[-<++++++++>]<++++.
+Print the marked cells as digits
+[-]<[<]>[++++++++++++++++++++++++++++++++++++++++++++++++.>]
+++++++++++.
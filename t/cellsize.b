@@ -0,0 +1,16 @@
+Print the width of a cell
+
+The first cell is multiplied by 256 until it wraps around to zero
+
+++++++++[>++++++++<-]>[<++++>-]<>+<[>-<[>>++++++++++++++++<<-]>>[<<+++++++++++++
++++>>-]<<>+<[>-<[>>++++++++++++++++<<-]>>[<<++++++++++++++++>>-]<<[>>+++++++++++
++++++<<-]>>[<<++++++++++++++++>>-]<<>+<[>-<>>>>+++++++++++++++++++++++++++++++++
++++++++++++++++++++++.--.[-]<<<<[-]]>[-<>>>>++++++++++++++++++++++++++++++++++++
++++++++++++++++.-.[-]<<<<>]<[-]]>[-<>>>>++++++++++++++++++++++++++++++++++++++++
++++++++++.+++++.[-]<<<<>]<[-]]>[-<>>>>++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++.[-]<<<<>]<>>>>++++++++++++++++++++++++++++++++.++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++.+++++++.+++++++++++.-----------
+-------------------------------------------------------------------------.++++++
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.++.+++++++..++++++
++.------------------------------------------------------------------------------
+---------------------------.[-]<<<<
@@ -0,0 +1,10 @@
+Loop on the zero tape is never entered
+[.]
+Known counter multiplication prints A
+++++++++[>++++++++<-]>+.
+Read B from input and move it to cell1 with unknown guard
+[-]>,[<+>-]<.
+The guard cell is zero after the move so this loop is never entered
+>[.]
+Newline
+++++++++++.
@@ -0,0 +1,5 @@
+This program reads no input so that all of it is executed at compile time
+and no IR code is left to be executed
+
+++++++++[>++++++++++<-]>-.----.
+[-]++++++++++.
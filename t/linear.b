@@ -0,0 +1,23 @@
+Counter step minus 3 (30 / 3 = 10 iterations; cell1 = 20 plus 45 = A)
+>[-]>[-]>[-]<<<[-]++++++++++++++++++++++++++++++
+[>++<---]
+>+++++++++++++++++++++++++++++++++++++++++++++.<
+Counter step plus 1 (250 wraps after 6 iterations; cell1 = 6 plus 60 = B)
+>[-]>[-]>[-]<<<[-]------
+[>+<+]
+>++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.<
+Repeated and out of order offsets (3 iterations; cell1 = cell2 = 6 plus 61 = C)
+>[-]>[-]>[-]<<<[-]+++
+[>>+<+<->+>+<<]
+>+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.<
+>>+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.<<
+Counter step plus 3 needs the modular inverse (85 iterations = U)
+>[-]>[-]>[-]<<<[-]+
+[>+<+++]
+>.<
+Counter decremented in the middle with a negative factor (4 iterations; cell1 = 90 minus 8 = R)
+>[-]>[-]>[-]<<<[-]++++
+[>>+<<->--<]
+>++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.<
+Newline
+[-]++++++++++.
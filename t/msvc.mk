@@ -29,7 +29,7 @@ version:
 $(OUTPUTS_DIR):
 	@$(MKDIR) $@
 
-interpreter: update_expects interpreter1 interpreter2
+interpreter: update_expects interpreter1 interpreter1-threaded interpreter1-packed interpreter2
 
 update_expects:
 	@for %f in (*.b) do \
@@ -55,6 +55,32 @@ interpreter1:
 			$(ECHO) Success || $(ECHO) Failed && exit /b 1 \
 		)
 
+interpreter1-threaded:
+	@for %f in (*.b) do \
+		@set /p MSG=Interpreter1 threaded test: %f ...< NUL & \
+		@if exist $(INPUTS_DIR)\%~nf.txt ( \
+			$(BRAINFUCK) -O1 --dispatch=threaded %~nf.b < $(INPUTS_DIR)\%~nf.txt > $(OUTPUTS_DIR)\%~nf.txt & \
+			$(DIFF) $(OUTPUTS_DIR)\%~nf.txt $(EXPECTS_DIR)\%~nf.txt > NUL && \
+			$(ECHO) Success || $(ECHO) Failed && exit /b 1 \
+		) else ( \
+			$(BRAINFUCK) -O1 --dispatch=threaded %~nf.b > $(OUTPUTS_DIR)\%~nf.txt & \
+			$(DIFF) $(OUTPUTS_DIR)\%~nf.txt $(EXPECTS_DIR)\%~nf.txt > NUL && \
+			$(ECHO) Success || $(ECHO) Failed && exit /b 1 \
+		)
+
+interpreter1-packed:
+	@for %f in (*.b) do \
+		@set /p MSG=Interpreter1 packed test: %f ...< NUL & \
+		@if exist $(INPUTS_DIR)\%~nf.txt ( \
+			$(BRAINFUCK) -O1 --dispatch=packed %~nf.b < $(INPUTS_DIR)\%~nf.txt > $(OUTPUTS_DIR)\%~nf.txt & \
+			$(DIFF) $(OUTPUTS_DIR)\%~nf.txt $(EXPECTS_DIR)\%~nf.txt > NUL && \
+			$(ECHO) Success || $(ECHO) Failed && exit /b 1 \
+		) else ( \
+			$(BRAINFUCK) -O1 --dispatch=packed %~nf.b > $(OUTPUTS_DIR)\%~nf.txt & \
+			$(DIFF) $(OUTPUTS_DIR)\%~nf.txt $(EXPECTS_DIR)\%~nf.txt > NUL && \
+			$(ECHO) Success || $(ECHO) Failed && exit /b 1 \
+		)
+
 interpreter2:
 	@for %f in (*.b) do \
 		@set /p MSG=Interpreter2 test: %f ...< NUL & \
@@ -0,0 +1,27 @@
+Reset cell and constant accumulator (cell2 = 6 times 5 = 30 then A)
+[-]+++++>[-]<>>[-]<<>>>[-]<<<
+[>+++[>++<-]<-]
+>>+++++++++++++++++++++++++++++++++++.<<
+Accumulator gets a reset cell (cell2 = 7 plus 3 times 3 = 16 then B and C)
+[-]++++>[-]+++++++<>>[-]<<>>>[-]<<<
+[>[>+<-]+++<-]
+>>++++++++++++++++++++++++++++++++++++++++++++++++++.<<
+>++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.<
+Accumulator loses a reset cell (cell2 = 100 minus 14 = V)
+[-]+++>[-]++++++++++<>>[-]++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++<<>>>[-]<<<
+[>[>-<-]++<-]
+>>.<<
+Counter step plus 3 runs 170 times (cell2 = 6 plus 169 times 2 = 88 = X)
+[-]++>[-]+++++<>>[-]<<>>>[-]<<<
+[>[>+<-]+>+<<+++]
+>>.<<
+Counter starts with zero (A)
+[-]>[-]+<>>[-]+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++<<>>>[-]<<<
+[>+[>+<-]<-]
+>>.<<
+Accumulator gets another accumulator and is not reduced (cell2 = 12 then A)
+[-]+++>[-]++++<>>[-]<<>>>[-]<<<
+[>[>+>+<<-]>>[<<+>>-]<<<-]
+>>+++++++++++++++++++++++++++++++++++++++++++++++++++++.<<
+Newline
+[-]++++++++++.
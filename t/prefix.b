@@ -0,0 +1,8 @@
+Build A in cell1 and space in cell2 with a loop then print them
+++++++++[>++++++++>++++<<-]>+.>.
+Read a character into cell3 and print it
+>,.
+Print B and C with the cells built before the input
+<<+.>.<+.
+Echo the rest of the line from a loop which starts reading in its body
+>>>+[,.----------]
@@ -0,0 +1,14 @@
+Read the length of the tape section from input so the scans run at run time
+>>>>,
+Fill cells 4 to 125 with 122 down to 1
+[[>+>+<<-]>>[<<+>>-]<-]
+Scan the whole section in both directions and print the cell before the end
+<[<]>.<>[>]<.>
+Clear cells 40 41 43 63 100 101
+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<[-]>[-]>>[-]>>>>>>>>>>>>>>>>>>>>[-]>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>[-]>[-]
+Scan with strides 2 and 4 forward
+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<[>>]<.><<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<[>>]<.><<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<[>>>>]<.>
+Scan with strides 2 and 4 backward
+>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>[<<]>.<>>>>>>>>>>>>>>>>>>>>>>>>>[<<]>.<>>>>>>>>>>>>>>>>>>>>>>[<<<<]>.<
+Newline
+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<++++++++++.